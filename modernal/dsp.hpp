@@ -0,0 +1,384 @@
+#ifndef MODERNAL_DSP_HPP
+#define MODERNAL_DSP_HPP
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+const double dsp_pi = 3.14159265358979323846;
+
+inline void samples_to_float(float * dst, const void * src, long long count, int bits) {
+    if (bits == 32) {
+        memcpy(dst, src, sizeof(float) * count);
+    } else if (bits == 16) {
+        const short * ptr = (const short *)src;
+        for (long long i = 0; i < count; ++i) {
+            dst[i] = ptr[i] * (1.0f / 32768.0f);
+        }
+    } else {
+        const unsigned char * ptr = (const unsigned char *)src;
+        for (long long i = 0; i < count; ++i) {
+            dst[i] = (ptr[i] - 128) * (1.0f / 128.0f);
+        }
+    }
+}
+
+inline void float_to_samples(void * dst, const float * src, long long count, int bits) {
+    if (bits == 32) {
+        memcpy(dst, src, sizeof(float) * count);
+    } else if (bits == 16) {
+        short * ptr = (short *)dst;
+        for (long long i = 0; i < count; ++i) {
+            float value = src[i] * 32768.0f;
+            value = value < -32768.0f ? -32768.0f : value > 32767.0f ? 32767.0f : value;
+            ptr[i] = (short)lrintf(value);
+        }
+    } else {
+        unsigned char * ptr = (unsigned char *)dst;
+        for (long long i = 0; i < count; ++i) {
+            float value = src[i] * 128.0f + 128.0f;
+            value = value < 0.0f ? 0.0f : value > 255.0f ? 255.0f : value;
+            ptr[i] = (unsigned char)lrintf(value);
+        }
+    }
+}
+
+inline void samples_to_int16(short * dst, const void * src, long long count, int bits) {
+    if (bits == 32) {
+        const float * ptr = (const float *)src;
+        for (long long i = 0; i < count; ++i) {
+            float value = ptr[i] * 32768.0f;
+            value = value < -32768.0f ? -32768.0f : value > 32767.0f ? 32767.0f : value;
+            dst[i] = (short)lrintf(value);
+        }
+    } else if (bits == 16) {
+        memcpy(dst, src, sizeof(short) * count);
+    } else {
+        const unsigned char * ptr = (const unsigned char *)src;
+        for (long long i = 0; i < count; ++i) {
+            dst[i] = (short)((ptr[i] - 128) << 8);
+        }
+    }
+}
+
+const int resample_phases = 256;
+const int resample_zero_crossings = 16;
+const int resample_lanes = 8;
+
+inline int resampled_frames(int frames, int src_rate, int dst_rate) {
+    return (int)(((long long)frames * dst_rate + src_rate - 1) / src_rate);
+}
+
+inline float resample_dot(const float * x, const float * h, int taps) {
+    float acc[resample_lanes] = {};
+    for (int k = 0; k < taps; k += resample_lanes) {
+        for (int l = 0; l < resample_lanes; ++l) {
+            acc[l] += x[k + l] * h[k + l];
+        }
+    }
+    float res = 0.0f;
+    for (int l = 0; l < resample_lanes; ++l) {
+        res += acc[l];
+    }
+    return res;
+}
+
+// Polyphase windowed-sinc resampler. Each output frame is a dot product of a
+// zero padded input window with one of resample_phases precomputed kernels.
+// The tap count is a multiple of resample_lanes so resample_dot vectorizes.
+
+inline bool resample(void * dst, int dst_frames, const void * src, int src_frames, int channels, int bits, int src_rate, int dst_rate) {
+    double step = (double)src_rate / dst_rate;
+    double cutoff = (dst_rate < src_rate ? (double)dst_rate / src_rate : 1.0) * 0.95;
+    int half = (int)ceil(resample_zero_crossings / cutoff);
+    int taps = (2 * half + resample_lanes - 1) / resample_lanes * resample_lanes;
+
+    long long padded_frames = (long long)src_frames + half + taps + 1;
+    float * table = (float *)malloc(sizeof(float) * (resample_phases + 1) * taps);
+    float * input = (float *)malloc(sizeof(float) * src_frames * channels);
+    float * padded = (float *)malloc(sizeof(float) * padded_frames);
+    float * output = (float *)malloc(sizeof(float) * dst_frames * channels);
+
+    if (!table || !input || !padded || !output) {
+        free(table);
+        free(input);
+        free(padded);
+        free(output);
+        return false;
+    }
+
+    for (int p = 0; p <= resample_phases; ++p) {
+        float * h = table + p * taps;
+        double frac = (double)p / resample_phases;
+        double total = 0.0;
+        for (int k = 0; k < taps; ++k) {
+            double x = k - (half - 1) - frac;
+            double value = 0.0;
+            if (fabs(x) < half) {
+                double arg = dsp_pi * cutoff * x;
+                double sinc = x == 0.0 ? 1.0 : sin(arg) / arg;
+                double u = (x + half) / (2.0 * half);
+                double window = 0.42 - 0.5 * cos(2.0 * dsp_pi * u) + 0.08 * cos(4.0 * dsp_pi * u);
+                value = cutoff * sinc * window;
+            }
+            h[k] = (float)value;
+            total += value;
+        }
+        for (int k = 0; k < taps; ++k) {
+            h[k] = (float)(h[k] / total);
+        }
+    }
+
+    samples_to_float(input, src, (long long)src_frames * channels, bits);
+
+    for (int c = 0; c < channels; ++c) {
+        memset(padded, 0, sizeof(float) * padded_frames);
+        for (int i = 0; i < src_frames; ++i) {
+            padded[half + i] = input[i * channels + c];
+        }
+        for (int j = 0; j < dst_frames; ++j) {
+            double t = j * step;
+            long long i0 = (long long)t;
+            int phase = (int)((t - i0) * resample_phases + 0.5);
+            output[j * channels + c] = resample_dot(padded + i0 + 1, table + phase * taps, taps);
+        }
+    }
+
+    float_to_samples(dst, output, (long long)dst_frames * channels, bits);
+
+    free(table);
+    free(input);
+    free(padded);
+    free(output);
+    return true;
+}
+
+enum {
+    generate_silence,
+    generate_sine,
+    generate_square,
+    generate_noise,
+    generate_sweep,
+};
+
+const int generate_lanes = 8;
+const int generate_block = 4096;
+
+// Mono float synthesis. Sine advances generate_lanes phasors by rotation and
+// re-anchors them every generate_block frames to keep long tones exact.
+
+inline void generate(float * dst, int frames, int kind, int rate, double tone, double end_tone, float amplitude, unsigned seed) {
+    switch (kind) {
+        case generate_silence: {
+            memset(dst, 0, sizeof(float) * frames);
+            break;
+        }
+        case generate_sine: {
+            double w = 2.0 * dsp_pi * tone / rate;
+            float rot_cos = (float)cos(w * generate_lanes);
+            float rot_sin = (float)sin(w * generate_lanes);
+            for (int start = 0; start < frames; start += generate_block) {
+                int end = start + generate_block < frames ? start + generate_block : frames;
+                float re[generate_lanes];
+                float im[generate_lanes];
+                for (int l = 0; l < generate_lanes; ++l) {
+                    re[l] = (float)cos(w * (start + l));
+                    im[l] = (float)sin(w * (start + l));
+                }
+                int i = start;
+                for (; i + generate_lanes <= end; i += generate_lanes) {
+                    for (int l = 0; l < generate_lanes; ++l) {
+                        dst[i + l] = im[l] * amplitude;
+                        float next_re = re[l] * rot_cos - im[l] * rot_sin;
+                        float next_im = re[l] * rot_sin + im[l] * rot_cos;
+                        re[l] = next_re;
+                        im[l] = next_im;
+                    }
+                }
+                for (int l = 0; i < end && l < generate_lanes; ++i, ++l) {
+                    dst[i] = im[l] * amplitude;
+                }
+            }
+            break;
+        }
+        case generate_square: {
+            double step = tone / rate;
+            for (int i = 0; i < frames; ++i) {
+                double phase = i * step;
+                dst[i] = phase - floor(phase) < 0.5 ? amplitude : -amplitude;
+            }
+            break;
+        }
+        case generate_noise: {
+            unsigned state[generate_lanes];
+            for (int l = 0; l < generate_lanes; ++l) {
+                state[l] = ((seed + 1) * 2654435761u + l * 40503u) | 1;
+            }
+            int i = 0;
+            for (; i + generate_lanes <= frames; i += generate_lanes) {
+                for (int l = 0; l < generate_lanes; ++l) {
+                    unsigned x = state[l];
+                    x ^= x << 13;
+                    x ^= x >> 17;
+                    x ^= x << 5;
+                    state[l] = x;
+                    dst[i + l] = ((int)x * (1.0f / 2147483648.0f)) * amplitude;
+                }
+            }
+            for (int l = 0; i < frames && l < generate_lanes; ++i, ++l) {
+                unsigned x = state[l];
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+                dst[i] = ((int)x * (1.0f / 2147483648.0f)) * amplitude;
+            }
+            break;
+        }
+        case generate_sweep: {
+            double duration = (double)frames / rate;
+            double slope = duration > 0.0 ? (end_tone - tone) / (2.0 * duration) : 0.0;
+            for (int i = 0; i < frames; ++i) {
+                double t = (double)i / rate;
+                double phase = t * (tone + slope * t);
+                dst[i] = (float)sin(2.0 * dsp_pi * (phase - floor(phase))) * amplitude;
+            }
+            break;
+        }
+    }
+}
+
+inline void interleave_mono(float * dst, const float * src, int frames, int channels) {
+    for (int i = 0; i < frames; ++i) {
+        for (int c = 0; c < channels; ++c) {
+            dst[i * channels + c] = src[i];
+        }
+    }
+}
+
+const int mix_lanes = 8;
+const int mix_block = 1024;
+
+// Accumulates PCM into a mono or stereo float bed. Input is converted in
+// blocks of mix_block frames; matching layouts use a lane pattern of
+// per-channel gains so the inner loop vectorizes. Saturation happens once
+// in float_to_samples after all inputs are summed.
+
+inline void mix_accumulate(float * dst, int dst_channels, const void * src, int src_channels, int bits, int frames, float left, float right) {
+    float block[mix_block * 2];
+    float pattern[mix_lanes];
+    for (int l = 0; l < mix_lanes; ++l) {
+        pattern[l] = src_channels == 2 && (l & 1) ? right : left;
+    }
+
+    int frame_size = src_channels * bits / 8;
+    for (int start = 0; start < frames; start += mix_block) {
+        int count = frames - start < mix_block ? frames - start : mix_block;
+        samples_to_float(block, (const char *)src + (size_t)start * frame_size, (long long)count * src_channels, bits);
+        float * out = dst + (size_t)start * dst_channels;
+
+        if (src_channels == dst_channels) {
+            int n = count * src_channels;
+            int i = 0;
+            for (; i + mix_lanes <= n; i += mix_lanes) {
+                for (int l = 0; l < mix_lanes; ++l) {
+                    out[i + l] += block[i + l] * pattern[l];
+                }
+            }
+            for (int l = 0; i < n && l < mix_lanes; ++i, ++l) {
+                out[i] += block[i] * pattern[l];
+            }
+        } else if (dst_channels == 2) {
+            for (int i = 0; i < count; ++i) {
+                out[i * 2] += block[i] * left;
+                out[i * 2 + 1] += block[i] * right;
+            }
+        } else {
+            for (int i = 0; i < count; ++i) {
+                out[i] += (block[i * 2] * left + block[i * 2 + 1] * right) * 0.5f;
+            }
+        }
+    }
+}
+
+const int ima4_block_frames = 65;
+
+const int ima4_index_table[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+const int ima4_step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97,
+    107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428,
+    4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350,
+    22385, 24623, 27086, 29794, 32767,
+};
+
+inline int ima4_size(int frames, int channels) {
+    int blocks = (frames + ima4_block_frames - 1) / ima4_block_frames;
+    return blocks * channels * (4 + (ima4_block_frames - 1) / 2);
+}
+
+inline int ima4_nibble(int sample, int & predictor, int & index) {
+    int diff = sample - predictor;
+    int nibble = 0;
+    if (diff < 0) {
+        nibble = 8;
+        diff = -diff;
+    }
+    int step = ima4_step_table[index];
+    int delta = step >> 3;
+    if (diff >= step) {
+        nibble |= 4;
+        diff -= step;
+        delta += step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        nibble |= 2;
+        diff -= step;
+        delta += step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        nibble |= 1;
+        delta += step;
+    }
+    predictor += (nibble & 8) ? -delta : delta;
+    predictor = predictor < -32768 ? -32768 : predictor > 32767 ? 32767 : predictor;
+    index += ima4_index_table[nibble & 7];
+    index = index < 0 ? 0 : index > 88 ? 88 : index;
+    return nibble;
+}
+
+// IMA4 blocks as decoded by OpenAL Soft with the default block alignment:
+// a 4 byte header per channel holding the first frame and step index, then
+// groups of 8 nibbles per channel, low nibble first. The tail is zero padded.
+
+inline void ima4_encode(unsigned char * dst, const short * src, int frames, int channels) {
+    int index[2] = {};
+    for (int start = 0; start < frames; start += ima4_block_frames) {
+        int predictor[2] = {};
+        for (int c = 0; c < channels; ++c) {
+            short first = src[start * channels + c];
+            predictor[c] = first;
+            dst[0] = (unsigned char)(first & 0xff);
+            dst[1] = (unsigned char)((first >> 8) & 0xff);
+            dst[2] = (unsigned char)index[c];
+            dst[3] = 0;
+            dst += 4;
+        }
+        for (int group = 1; group < ima4_block_frames; group += 8) {
+            for (int c = 0; c < channels; ++c) {
+                for (int k = 0; k < 8; k += 2) {
+                    int i0 = start + group + k;
+                    int s0 = i0 < frames ? src[i0 * channels + c] : 0;
+                    int s1 = i0 + 1 < frames ? src[(i0 + 1) * channels + c] : 0;
+                    int lo = ima4_nibble(s0, predictor[c], index[c]);
+                    int hi = ima4_nibble(s1, predictor[c], index[c]);
+                    *dst++ = (unsigned char)(lo | (hi << 4));
+                }
+            }
+        }
+    }
+}
+
+#endif
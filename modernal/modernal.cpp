@@ -1,7 +1,22 @@
+#define PY_SSIZE_T_CLEAN
 #include <Python.h>
 #include <structmember.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
 #include "openal.hpp"
+#include "dsp.hpp"
+#include "xxhash.hpp"
 
 #if defined(_WIN32) || defined(_WIN64)
 
@@ -49,13 +64,66 @@ void * _load_al_method_raw(void * libal, const char * method) {
 
 #endif
 
-void * load_al_method(void * libal, const char * name) {
-    if (PyErr_Occurred()) {
+#if defined(_WIN32) || defined(_WIN64)
+
+char * map_file(const char * path, size_t * size) {
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+    LARGE_INTEGER file_size = {};
+    GetFileSizeEx(file, &file_size);
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) {
+        return NULL;
+    }
+    char * res = (char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    *size = (size_t)file_size.QuadPart;
+    return res;
+}
+
+void unmap_file(char * ptr, size_t size) {
+    UnmapViewOfFile(ptr);
+}
+
+#else
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+char * map_file(const char * path, size_t * size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
         return NULL;
     }
+    struct stat st = {};
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    void * res = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (res == MAP_FAILED) {
+        return NULL;
+    }
+    *size = (size_t)st.st_size;
+    return (char *)res;
+}
+
+void unmap_file(char * ptr, size_t size) {
+    munmap(ptr, size);
+}
+
+#endif
+
+void * load_al_method(void * libal, const char * name, const char ** missing) {
     void * res = load_al_method_raw(libal, name);
-    if (!res) {
-        PyErr_Format(PyExc_Exception, "%s not found", name);
+    if (!res && !*missing) {
+        *missing = name;
     }
     return res;
 }
@@ -79,14 +147,35 @@ inline int py_floats(float * ptr, int min, int max, PyObject * tup) {
     return size;
 }
 
+inline double py_item(PyObject * seq, Py_ssize_t index, double fallback) {
+    if (seq == Py_None) {
+        return fallback;
+    }
+    PyObject * item = PySequence_GetItem(seq, index);
+    if (!item) {
+        return fallback;
+    }
+    double res = PyFloat_AsDouble(item);
+    Py_DECREF(item);
+    return res;
+}
+
 #define new_ref(obj) (Py_INCREF(obj), obj)
 
 PyObject * empty_tuple;
+PyObject * error_type;
+
+unsigned long long context_serial;
 
 PyTypeObject * Context_type;
 PyTypeObject * Buffer_type;
 PyTypeObject * Listener_type;
 PyTypeObject * Source_type;
+PyTypeObject * Bank_type;
+PyTypeObject * Emitter_type;
+PyTypeObject * EffectSlot_type;
+PyTypeObject * Filter_type;
+PyTypeObject * CallbackBuffer_type;
 
 struct BaseObject {
     PyObject_HEAD
@@ -98,14 +187,50 @@ struct Context : public BaseObject {
     ALCdevice * device;
     ALCcontext * ctx;
     void * libal;
+    bool debug;
+    int device_frequency;
+    PyObject * attributes;
 
     struct Listener * listener;
 
+    struct {
+        char * ptr;
+        size_t size;
+        bool busy;
+    } scratch;
+
+    std::unordered_map<unsigned long long, struct Buffer *> * buffer_cache;
+    int cache_hits;
+    int cache_misses;
+
+    long long memory_budget;
+    long long resident_bytes;
+    unsigned long long use_clock;
+    unsigned long long uid;
+    unsigned long long object_serial;
+    int evictions;
+    int reuploads;
+
+    struct EmitterGrid * grid;
+    struct Automation * automation;
+    struct Scheduler * scheduler;
+    struct CommandRing * commands;
+    struct ContextOpen * opening;
+    bool opened;
+    int occlusion_filter;
+    bool loop_points;
+
     struct {
         PyObject * format_mono8;
         PyObject * format_mono16;
         PyObject * format_stereo8;
         PyObject * format_stereo16;
+        PyObject * format_mono_float32;
+        PyObject * format_stereo_float32;
+        PyObject * format_mono_ima4;
+        PyObject * format_stereo_ima4;
+        PyObject * format_mono_msadpcm;
+        PyObject * format_stereo_msadpcm;
         PyObject * inverse_distance;
         PyObject * inverse_distance_clamped;
         PyObject * linear_distance;
@@ -119,6 +244,10 @@ struct Context : public BaseObject {
         LPALCCREATECONTEXT CreateContext;
         LPALCMAKECONTEXTCURRENT MakeContextCurrent;
         LPALCGETERROR GetError;
+        LPALCGETINTEGERV GetIntegerv;
+        LPALCISEXTENSIONPRESENT IsExtensionPresent;
+        LPALCGETPROCADDRESS GetProcAddress;
+        LPALCGETINTEGER64VSOFT GetInteger64vSOFT;
     } alc;
 
     struct {
@@ -195,472 +324,4392 @@ struct Context : public BaseObject {
         LPALDOPPLERVELOCITY DopplerVelocity;
         LPALSPEEDOFSOUND SpeedOfSound;
         LPALDISTANCEMODEL DistanceModel;
+        LPALSOURCEPLAYATTIMESOFT SourcePlayAtTimeSOFT;
+        LPALGETSOURCEI64VSOFT GetSourcei64vSOFT;
+        LPALBUFFERCALLBACKSOFT BufferCallbackSOFT;
+        LPALDEFERUPDATESSOFT DeferUpdatesSOFT;
+        LPALPROCESSUPDATESSOFT ProcessUpdatesSOFT;
+        LPALGENEFFECTS GenEffects;
+        LPALDELETEEFFECTS DeleteEffects;
+        LPALEFFECTI Effecti;
+        LPALEFFECTF Effectf;
+        LPALGENFILTERS GenFilters;
+        LPALDELETEFILTERS DeleteFilters;
+        LPALFILTERI Filteri;
+        LPALFILTERF Filterf;
+        LPALGENAUXILIARYEFFECTSLOTS GenAuxiliaryEffectSlots;
+        LPALDELETEAUXILIARYEFFECTSLOTS DeleteAuxiliaryEffectSlots;
+        LPALAUXILIARYEFFECTSLOTI AuxiliaryEffectSloti;
+        LPALAUXILIARYEFFECTSLOTF AuxiliaryEffectSlotf;
     } al;
 };
 
+struct Region {
+    int start;
+    int end;
+};
+
+// The hash alone does not identify the data. A cache hit also has to match
+// the length and the upload parameters of the data that was hashed.
+
+struct CacheKey {
+    unsigned long long hash;
+    long long size;
+    int format;
+    int frequency;
+    int resample_to;
+};
+
 struct Buffer : public BaseObject {
     struct Context * ctx;
+    unsigned long long serial;
     int alo;
     int format;
     int frequency;
     int size;
     int bound;
+    CacheKey key;
+    bool cached;
+    PyObject * cache_data;
+    PyObject * source_owner;
+    struct Bank * source_bank;
+    const char * source_data;
+    bool resident;
+    bool evicted;
+    unsigned long long last_use;
+    std::unordered_map<std::string, Region> * regions;
+    bool loop_region;
+};
+
+// Byte ring between a producer and the mixer callback. The producer only
+// advances write and the mixer only advances read, so no lock is needed.
+// The capacity is a power of two.
+
+struct StreamRing {
+    char * data;
+    unsigned long long capacity;
+    std::atomic<unsigned long long> write;
+    std::atomic<unsigned long long> read;
+    std::atomic<unsigned long long> underruns;
+    unsigned char silence;
+};
+
+// reserve() exports the free span through the buffer protocol so that release
+// can refuse while a view into the ring is still alive.
+
+struct CallbackBuffer : public Buffer {
+    StreamRing * ring;
+    char * reserved;
+    Py_ssize_t reserved_size;
+    Py_ssize_t exports;
+};
+
+struct PendingUpload {
+    Buffer * buffer;
+    PyObject * data;
+    int format;
+    int frequency;
+    int resample_to;
+};
+
+struct ContextOpen {
+    std::mutex lock;
+    std::condition_variable done;
+    std::string libal;
+    std::string device_name;
+    bool default_device;
+    std::vector<int> attribs;
+    int state;
+    bool finishing;
+    bool referenced;
+    std::thread::id finisher;
+    PyObject * error_kind;
+    std::string error;
+    std::vector<PendingUpload> pending;
 };
 
 struct Listener : public BaseObject {
     struct Context * ctx;
 };
 
+// Sound bank file: BankHeader, count BankEntry records sorted by name,
+// the name table and 16 byte aligned payloads. All offsets are absolute.
+
+const char bank_magic[8] = {'M', 'A', 'L', 'B', 'A', 'N', 'K', 0};
+const unsigned bank_version = 1;
+
+struct BankHeader {
+    char magic[8];
+    unsigned version;
+    unsigned count;
+    unsigned long long names_offset;
+    unsigned long long names_size;
+};
+
+struct BankEntry {
+    unsigned long long offset;
+    unsigned size;
+    int format;
+    int frequency;
+    unsigned name_offset;
+    unsigned name_length;
+    unsigned reserved;
+};
+
+struct Bank : public BaseObject {
+    struct Context * ctx;
+    char * ptr;
+    size_t size;
+    int count;
+    const BankEntry * entries;
+    const char * names;
+    struct Buffer ** buffers;
+};
+
 struct Source : public BaseObject {
     struct Context * ctx;
     struct Buffer * buffer;
+    unsigned long long serial;
     int alo;
     bool playing;
 };
 
-void BaseObject_dealloc(BaseObject * self) {
-    Py_TYPE(self)->tp_free(self);
-}
+struct Emitter : public BaseObject {
+    struct Context * ctx;
+    struct Buffer * buffer;
+    float position[3];
+    float max_distance;
+    float gain;
+    bool loop;
+    long long cell;
+    int cell_index;
+    int audible_index;
+    int voice;
+    bool waiting;
+};
 
-Buffer * Context_meth_buffer(Context * self, PyObject * args, PyObject * kwargs) {
-    static char * keywords[] = {"data", "format", "frequency", NULL};
+struct EffectSlot : public BaseObject {
+    struct Context * ctx;
+    int alo;
+    int effect;
+    int type;
+    float gain;
+};
 
-    PyObject * data = NULL;
-    int format = AL_FORMAT_MONO16;
-    int frequency = 44100;
+struct Filter : public BaseObject {
+    struct Context * ctx;
+    int alo;
+    int type;
+    float gain;
+    float gain_hf;
+    float gain_lf;
+};
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|Oii", keywords, &data, &format, &frequency)) {
-        return NULL;
-    }
+// Uniform grid of registered emitters. Emitters within max_distance of the
+// listener are kept in audible and get an AL source from the voice pool.
+// Audible emitters that found the pool exhausted queue in waiting and take
+// freed voices in the order they started waiting.
 
-    if (!PyArg_ParseTuple(args, "|O", &data)) {
-        return NULL;
-    }
+struct EmitterGrid {
+    std::unordered_map<long long, std::vector<Emitter *> > cells;
+    std::vector<Emitter *> audible;
+    std::deque<Emitter *> waiting;
+    std::vector<int> free_voices;
+    float listener[3];
+    float cell_size;
+    float reach;
+    int voices;
+    int max_voices;
+};
 
-    Buffer * res = PyObject_New(Buffer, Buffer_type);
-    res->prev = self;
-    res->next = self->next;
-    self->next = res;
-    res->ctx = self;
+bool emitters_refresh(Context * ctx);
+bool scheduler_reap(Context * self);
 
-    res->format = format;
-    res->frequency = frequency;
-    res->size = 0;
-    res->bound = 0;
+enum {
+    curve_linear,
+    curve_smooth,
+    curve_exponential,
+};
 
-    self->al.GenBuffers(1, (ALuint *)&res->alo);
-    if (data) {
-        PyObject * call = PyObject_CallMethod((PyObject *)res, "write", "Oii", data, format, frequency);
-        Py_XDECREF(call);
-        if (!call) {
-            return NULL;
-        }
+struct Ramp {
+    int source;
+    int param;
+    int curve;
+    float start;
+    float target;
+    double begin;
+    double duration;
+};
+
+struct Keyframe {
+    double time;
+    float position[3];
+};
+
+struct Path {
+    int source;
+    bool loop;
+    double begin;
+    std::vector<Keyframe> keyframes;
+};
+
+// Ramps and paths are evaluated at control_rate by a native thread that calls
+// the AL source functions directly, without the GIL and without error checks.
+
+struct Automation {
+    std::mutex lock;
+    std::condition_variable wake;
+    std::vector<Ramp> ramps;
+    std::vector<Path> paths;
+    LPALSOURCEF Sourcef;
+    LPALSOURCEFV Sourcefv;
+    double period;
+    bool started;
+};
+
+struct ScheduledEvent {
+    std::chrono::steady_clock::time_point when;
+    int source;
+    bool play;
+};
+
+// Fallback for play_at without AL_SOFT_source_start_delay and for stop_at.
+// The thread sleeps until just before the earliest event and spins the rest.
+
+struct Scheduler {
+    std::mutex lock;
+    std::condition_variable wake;
+    std::vector<ScheduledEvent> events;
+    std::vector<int> stopped;
+    LPALSOURCEPLAY SourcePlay;
+    LPALSOURCESTOP SourceStop;
+    bool started;
+};
+
+const char * al_error_name(int error) {
+    switch (error) {
+        case AL_INVALID_NAME: return "AL_INVALID_NAME";
+        case AL_INVALID_ENUM: return "AL_INVALID_ENUM";
+        case AL_INVALID_VALUE: return "AL_INVALID_VALUE";
+        case AL_INVALID_OPERATION: return "AL_INVALID_OPERATION";
+        case AL_OUT_OF_MEMORY: return "AL_OUT_OF_MEMORY";
     }
-    return res;
+    return "unknown error";
 }
 
-PyObject * Buffer_meth_write(Buffer * self, PyObject * args, PyObject * kwargs) {
-    static char * keywords[] = {"data", "format", "frequency", NULL};
+const char * alc_error_name(int error) {
+    switch (error) {
+        case ALC_INVALID_DEVICE: return "ALC_INVALID_DEVICE";
+        case ALC_INVALID_CONTEXT: return "ALC_INVALID_CONTEXT";
+        case ALC_INVALID_ENUM: return "ALC_INVALID_ENUM";
+        case ALC_INVALID_VALUE: return "ALC_INVALID_VALUE";
+        case ALC_OUT_OF_MEMORY: return "ALC_OUT_OF_MEMORY";
+    }
+    return "unknown error";
+}
 
-    Py_buffer view = {};
-    int format = self->format;
-    int frequency = self->frequency;
+// Release is the raw call, Debug checks alGetError and raises modernal.Error naming the call.
+// The policy is chosen per context with create_context(debug=True). Debug drains
+// the error state first, since the automation and scheduler threads call AL
+// directly and their errors must not be blamed on the next checked call.
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "y*|ii", keywords, &view, &format, &frequency)) {
-        return NULL;
+struct Release {
+    template <typename Func, typename ... Args>
+    static inline bool al(Context *, const char *, Func func, Args ... args) {
+        func(args...);
+        return true;
     }
+};
 
-    if (self->bound != 0) {
-        PyErr_BadInternalCall();
-        return NULL;
+struct Debug {
+    template <typename Func, typename ... Args>
+    static bool al(Context * ctx, const char * name, Func func, Args ... args) {
+        ctx->al.GetError();
+        func(args...);
+        int error = ctx->al.GetError();
+        if (error != AL_NO_ERROR) {
+            PyErr_Format(error_type, "al%s failed with %s", name, al_error_name(error));
+            return false;
+        }
+        return true;
     }
+};
 
-    self->format = format;
-    self->frequency = frequency;
-    self->size = (int)view.len;
+// Async dispatch: setters whose parameters are all scalars are captured into
+// fixed size commands on a single producer, single consumer ring. Python is the
+// only producer, since it always pushes while holding the GIL. A native thread
+// drains the ring into the AL function table. Calls that take pointers read or
+// write caller memory, so they flush the ring first and run synchronously.
+// With debug=True errors are checked on the drain thread and raised by the next flush.
 
-    self->ctx->al.BufferData(self->alo, self->format, view.buf, self->size, self->frequency);
-    Py_RETURN_NONE;
-}
+const int command_ring_size = 4096;
+const int command_storage = 48;
 
-PyMethodDef Buffer_methods[] = {
-    {"write", (PyCFunction)Buffer_meth_write, METH_VARARGS | METH_KEYWORDS, NULL},
-    {},
+struct Command {
+    void (* invoke)(void * storage);
+    const char * name;
+    alignas(8) char storage[command_storage];
 };
 
-PyMemberDef Buffer_members[] = {
-    {"format", T_INT, offsetof(Buffer, format), READONLY, NULL},
-    {"frequency", T_INT, offsetof(Buffer, frequency), READONLY, NULL},
-    {"size", T_INT, offsetof(Buffer, size), READONLY, NULL},
-    {"alo", T_INT, offsetof(Buffer, alo), READONLY, NULL},
-    {},
+struct CommandRing {
+    Command commands[command_ring_size];
+    std::atomic<unsigned> head;
+    std::atomic<unsigned> tail;
+    std::atomic<bool> idle;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable drained;
+    LPALGETERROR GetError;
+    bool debug;
+    std::string error;
 };
 
-PyType_Slot Buffer_slots[] = {
-    {Py_tp_methods, Buffer_methods},
-    {Py_tp_members, Buffer_members},
-    {Py_tp_dealloc, (void *)BaseObject_dealloc},
-    {},
+template <typename ... T>
+struct any_pointer {
+    static const bool value = false;
 };
 
-PyObject * Listener_meth_change(Listener * self, PyObject * args, PyObject * kwargs) {
-    static char * keywords[] = {
-        "gain",
-        "position",
-        "velocity",
-        "orientation",
-        NULL,
-    };
+template <typename T, typename ... Rest>
+struct any_pointer<T, Rest ...> {
+    static const bool value = std::is_pointer<T>::value || any_pointer<Rest ...>::value;
+};
 
-    PyObject * gain = Py_None;
-    PyObject * position = Py_None;
-    PyObject * velocity = Py_None;
-    PyObject * orientation = Py_None;
+template <typename Call>
+void command_invoke(void * storage) {
+    (*(Call *)storage)();
+}
 
-    int args_ok = PyArg_ParseTupleAndKeywords(
-        args,
-        kwargs,
-        "|OOOO",
-        keywords,
-        &gain,
-        &position,
-        &velocity,
-        &orientation
-    );
+void command_ring_run(CommandRing * self) {
+    while (true) {
+        unsigned tail = self->tail.load(std::memory_order_relaxed);
+        if (tail == self->head.load()) {
+            std::unique_lock<std::mutex> guard(self->lock);
+            self->idle = true;
+            self->drained.notify_all();
+            self->wake.wait(guard, [self, tail]() { return self->head.load() != tail; });
+            self->idle = false;
+            continue;
+        }
 
-    if (!args_ok) {
-        return NULL;
+        Command & command = self->commands[tail % command_ring_size];
+        command.invoke(command.storage);
+        if (self->debug) {
+            int error = self->GetError();
+            if (error != AL_NO_ERROR) {
+                std::lock_guard<std::mutex> guard(self->lock);
+                if (self->error.empty()) {
+                    self->error = std::string("al") + command.name + " failed with " + al_error_name(error);
+                }
+            }
+        }
+        self->tail.store(tail + 1, std::memory_order_release);
     }
+}
 
-    if (gain != Py_None) {
-        self->ctx->al.Listenerf(AL_GAIN, (float)PyFloat_AsDouble(gain));
+template <typename Call>
+void command_ring_push(CommandRing * self, const char * name, const Call & call) {
+    static_assert(sizeof(Call) <= command_storage, "command too large");
+    unsigned head = self->head.load(std::memory_order_relaxed);
+    while (head - self->tail.load(std::memory_order_acquire) >= (unsigned)command_ring_size) {
+        std::this_thread::yield();
     }
-    if (position != Py_None) {
-        float value[3] = {};
-        py_floats(value, 3, 3, position);
-        self->ctx->al.Listenerfv(AL_POSITION, value);
+    Command & command = self->commands[head % command_ring_size];
+    new (command.storage) Call(call);
+    command.invoke = command_invoke<Call>;
+    command.name = name;
+    self->head.store(head + 1);
+    if (self->idle.load()) {
+        std::lock_guard<std::mutex> guard(self->lock);
+        self->wake.notify_one();
     }
-    if (velocity != Py_None) {
-        float value[3] = {};
-        py_floats(value, 3, 3, velocity);
-        self->ctx->al.Listenerfv(AL_VELOCITY, value);
+}
+
+bool command_ring_flush(CommandRing * self) {
+    if (self->head.load() != self->tail.load()) {
+        Py_BEGIN_ALLOW_THREADS
+        {
+            std::unique_lock<std::mutex> guard(self->lock);
+            self->drained.wait(guard, [self]() { return self->head.load() == self->tail.load(); });
+        }
+        Py_END_ALLOW_THREADS
     }
-    if (orientation != Py_None) {
-        float value[6] = {};
-        py_floats(value, 6, 6, orientation);
-        self->ctx->al.Listenerfv(AL_ORIENTATION, value);
+    std::lock_guard<std::mutex> guard(self->lock);
+    if (!self->error.empty()) {
+        PyErr_Format(error_type, "%s", self->error.c_str());
+        self->error.clear();
+        return false;
     }
-    Py_RETURN_NONE;
+    return true;
 }
 
-PyType_Spec Buffer_spec = {"modernal.Buffer", sizeof(Buffer), 0, Py_TPFLAGS_DEFAULT, Buffer_slots};
-
-PyMethodDef Listener_methods[] = {
-    {"change", (PyCFunction)Listener_meth_change, METH_VARARGS | METH_KEYWORDS, NULL},
-    {},
+struct Async {
+    template <typename Result, typename ... Params, typename ... Args>
+    static bool al(Context * ctx, const char * name, Result (AL_APIENTRY * func)(Params ...), Args ... args) {
+        if (any_pointer<Params ...>::value || !std::is_void<Result>::value) {
+            if (!command_ring_flush(ctx->commands)) {
+                return false;
+            }
+            return ctx->debug ? Debug::al(ctx, name, func, args...) : Release::al(ctx, name, func, args...);
+        }
+        command_ring_push(ctx->commands, name, [func, args...]() { func(args...); });
+        return true;
+    }
 };
 
-PyType_Slot Listener_slots[] = {
-    {Py_tp_methods, Listener_methods},
-    {Py_tp_dealloc, (void *)BaseObject_dealloc},
-    {},
-};
+// Returns 1 once the context is open, 0 on timeout and -1 with an exception set.
+// Every al_call waits here, so a context created with async_open=True blocks
+// only at the first call that actually needs the device.
 
-PyType_Spec Listener_spec = {"modernal.Listener", sizeof(Listener), 0, Py_TPFLAGS_DEFAULT, Listener_slots};
+int context_ready(Context * self, double timeout);
 
-Source * Context_meth_source(Context * self, PyObject * args, PyObject * kwargs) {
-    static char * keywords[] = {"buffer", NULL};
+#define al_call(context, name, ...) ( \
+    ((context)->opened || context_ready((context), -1.0) > 0) && ( \
+    (context)->commands ? \
+    Async::al((context), #name, (context)->al.name, ##__VA_ARGS__) : \
+    (context)->debug ? \
+    Debug::al((context), #name, (context)->al.name, ##__VA_ARGS__) : \
+    Release::al((context), #name, (context)->al.name, ##__VA_ARGS__)) \
+)
 
-    PyObject * buffer = Py_None;
+int format_channels(int format) {
+    switch (format) {
+        case AL_FORMAT_MONO8: return 1;
+        case AL_FORMAT_MONO16: return 1;
+        case AL_FORMAT_STEREO8: return 2;
+        case AL_FORMAT_STEREO16: return 2;
+        case AL_FORMAT_MONO_FLOAT32: return 1;
+        case AL_FORMAT_STEREO_FLOAT32: return 2;
+    }
+    return 0;
+}
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O!", keywords, Buffer_type, &buffer)) {
-        return NULL;
+int format_bits(int format) {
+    switch (format) {
+        case AL_FORMAT_MONO8: return 8;
+        case AL_FORMAT_MONO16: return 16;
+        case AL_FORMAT_STEREO8: return 8;
+        case AL_FORMAT_STEREO16: return 16;
+        case AL_FORMAT_MONO_FLOAT32: return 32;
+        case AL_FORMAT_STEREO_FLOAT32: return 32;
     }
+    return 0;
+}
 
-    Source * res = PyObject_New(Source, Source_type);
-    res->prev = self;
-    res->next = self->next;
-    self->next = res;
-    res->ctx = self;
+void buffer_set_resident(Buffer * self, bool resident) {
+    if (self->resident != resident) {
+        self->ctx->resident_bytes += resident ? self->size : -self->size;
+        self->resident = resident;
+    }
+}
 
-    res->buffer = NULL;
-    res->playing = false;
+// New contents invalidate region offsets. BufferData also resets the loop points.
 
-    self->al.GenSources(1, (ALuint *)&res->alo);
+void buffer_clear_regions(Buffer * self) {
+    delete self->regions;
+    self->regions = NULL;
+    self->loop_region = false;
+}
 
-    if (PyObject_SetAttrString((PyObject *)res, "buffer", buffer) < 0) {
-        return NULL;
+void buffer_detach_source(Buffer * self) {
+    Py_CLEAR(self->source_owner);
+    self->source_bank = NULL;
+    self->source_data = NULL;
+    self->evicted = false;
+}
+
+bool buffer_make_resident(Buffer * self) {
+    self->last_use = ++self->ctx->use_clock;
+    if (self->resident) {
+        return true;
+    }
+    if (!al_call(self->ctx, BufferData, self->alo, self->format, self->source_data, self->size, self->frequency)) {
+        return false;
+    }
+    if (self->evicted) {
+        self->ctx->reuploads += 1;
+        self->evicted = false;
     }
+    buffer_set_resident(self, true);
+    return true;
+}
 
-    return res;
+bool buffer_lru_order(const Buffer * a, const Buffer * b) {
+    return a->last_use < b->last_use;
 }
 
-PyObject * Source_meth_change(Source * self, PyObject * args, PyObject * kwargs) {
-    static char * keywords[] = {
-        "loop",
-        "gain",
-        "pitch",
-        "time",
-        "min_gain",
-        "max_gain",
-        "max_distance",
-        "rolloff_factor",
-        "cone_outer_gain",
-        "cone_inner_angle",
-        "cone_outer_angle",
-        "reference_dinstance",
-        "position",
-        "velocity",
-        "direction",
-        NULL,
-    };
+// Buffers that can be re-uploaded from their source data and are not bound
+// to any source are released least recently played first, down to 7/8 of
+// the budget so that the scan does not run on every upload.
 
-    PyObject * loop = Py_None;
-    PyObject * gain = Py_None;
-    PyObject * pitch = Py_None;
-    PyObject * time = Py_None;
-    PyObject * min_gain = Py_None;
-    PyObject * max_gain = Py_None;
-    PyObject * max_distance = Py_None;
+bool residency_enforce(Context * self) {
+    if (!self->memory_budget || self->resident_bytes <= self->memory_budget) {
+        return true;
+    }
+
+    if (!scheduler_reap(self)) {
+        return false;
+    }
+
+    std::vector<Buffer *> candidates;
+    for (BaseObject * obj = self->next; obj != self; obj = obj->next) {
+        if (Py_TYPE(obj) == Buffer_type) {
+            Buffer * buffer = (Buffer *)obj;
+            if (buffer->resident && buffer->bound == 0 && buffer->source_data && buffer->size) {
+                candidates.push_back(buffer);
+            }
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), buffer_lru_order);
+
+    long long target = self->memory_budget - self->memory_budget / 8;
+    for (size_t i = 0; i < candidates.size() && self->resident_bytes > target; ++i) {
+        Buffer * buffer = candidates[i];
+        if (!al_call(self, BufferData, buffer->alo, buffer->format, (const void *)NULL, 0, buffer->frequency)) {
+            return false;
+        }
+        buffer_set_resident(buffer, false);
+        buffer->evicted = true;
+        self->evictions += 1;
+    }
+    return true;
+}
+
+void buffer_uncache(Buffer * self) {
+    if (self->cached) {
+        self->ctx->buffer_cache->erase(self->key.hash);
+        self->cached = false;
+        Py_CLEAR(self->cache_data);
+        Py_DECREF(self);
+    }
+}
+
+int generator_kind(const char * name) {
+    if (!strcmp(name, "silence")) {
+        return generate_silence;
+    }
+    if (!strcmp(name, "sine")) {
+        return generate_sine;
+    }
+    if (!strcmp(name, "square")) {
+        return generate_square;
+    }
+    if (!strcmp(name, "noise")) {
+        return generate_noise;
+    }
+    if (!strcmp(name, "sweep")) {
+        return generate_sweep;
+    }
+    return -1;
+}
+
+// Never returns NULL for an empty request, so NULL always means out of memory.
+
+char * scratch_acquire(Context * self, size_t size) {
+    if (!size) {
+        size = 1;
+    }
+    if (self->scratch.busy) {
+        return (char *)malloc(size);
+    }
+    if (size > self->scratch.size) {
+        char * ptr = (char *)realloc(self->scratch.ptr, size);
+        if (!ptr) {
+            return NULL;
+        }
+        self->scratch.ptr = ptr;
+        self->scratch.size = size;
+    }
+    self->scratch.busy = true;
+    return self->scratch.ptr;
+}
+
+void scratch_release(Context * self, char * ptr) {
+    if (ptr == self->scratch.ptr) {
+        self->scratch.busy = false;
+    } else {
+        free(ptr);
+    }
+}
+
+void BaseObject_dealloc(BaseObject * self) {
+    Py_TYPE(self)->tp_free(self);
+}
+
+void object_unlink(BaseObject * self) {
+    self->next->prev = self->prev;
+    self->prev->next = self->next;
+    self->prev = self;
+    self->next = self;
+}
+
+Buffer * buffer_link(Context * self, PyTypeObject * type, int format, int frequency) {
+    Buffer * res = PyObject_New(Buffer, type);
+    res->prev = self;
+    res->next = self->next;
+    self->next->prev = res;
+    self->next = res;
+    res->ctx = self;
+    res->serial = ++self->object_serial;
+
+    res->alo = 0;
+    res->format = format;
+    res->frequency = frequency;
+    res->size = 0;
+    res->bound = 0;
+    res->key.hash = 0;
+    res->cached = false;
+    res->cache_data = NULL;
+    res->source_owner = NULL;
+    res->source_bank = NULL;
+    res->source_data = NULL;
+    res->resident = true;
+    res->evicted = false;
+    res->last_use = ++self->use_clock;
+    res->regions = NULL;
+    res->loop_region = false;
+    return res;
+}
+
+Buffer * Context_meth_buffer(Context * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"data", "format", "frequency", "resample_to", NULL};
+
+    PyObject * data = NULL;
+    int format = AL_FORMAT_MONO16;
+    int frequency = 44100;
+    int resample_to = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|Oiii", keywords, &data, &format, &frequency, &resample_to)) {
+        return NULL;
+    }
+
+    if (!PyArg_ParseTuple(args, "|O", &data)) {
+        return NULL;
+    }
+
+    bool cache = self->buffer_cache && data && data != Py_None;
+    CacheKey key = {0, 0, format, frequency, resample_to};
+
+    if (cache) {
+        Py_buffer view = {};
+        if (PyObject_GetBuffer(data, &view, PyBUF_SIMPLE) < 0) {
+            return NULL;
+        }
+        unsigned long long seed = (unsigned long long)format * xxh_prime1 ^ (unsigned long long)frequency * xxh_prime2 ^ (unsigned long long)resample_to * xxh_prime3;
+        key.size = view.len;
+        Py_BEGIN_ALLOW_THREADS
+        key.hash = xxh64(view.buf, view.len, seed);
+        Py_END_ALLOW_THREADS
+
+        // a hit is only trusted after comparing the bytes the entry was made from
+        std::unordered_map<unsigned long long, Buffer *>::iterator it = self->buffer_cache->find(key.hash);
+        if (it != self->buffer_cache->end()) {
+            Buffer * cached = it->second;
+            bool same = cached->key.size == key.size && cached->key.format == key.format;
+            same = same && cached->key.frequency == key.frequency && cached->key.resample_to == key.resample_to;
+            same = same && !memcmp(PyBytes_AS_STRING(cached->cache_data), view.buf, view.len);
+            if (same) {
+                PyBuffer_Release(&view);
+                self->cache_hits += 1;
+                return new_ref(cached);
+            }
+            // a collision keeps the existing entry and uploads this data uncached
+            cache = false;
+        }
+        PyBuffer_Release(&view);
+        self->cache_misses += 1;
+    }
+
+    Buffer * res = buffer_link(self, Buffer_type, format, frequency);
+
+    int ready = context_ready(self, 0.0);
+    if (ready < 0) {
+        object_unlink(res);
+        Py_DECREF(res);
+        return NULL;
+    }
+    if (!ready) {
+        PendingUpload upload = {new_ref(res), data && data != Py_None ? new_ref(data) : NULL, format, frequency, resample_to};
+        self->opening->pending.push_back(upload);
+    } else if (!al_call(self, GenBuffers, 1, (ALuint *)&res->alo)) {
+        object_unlink(res);
+        Py_DECREF(res);
+        return NULL;
+    }
+    if (ready && data) {
+        PyObject * call = PyObject_CallMethod((PyObject *)res, "write", "Oiii", data, format, frequency, resample_to);
+        Py_XDECREF(call);
+        if (!call) {
+            object_unlink(res);
+            Py_DECREF(res);
+            return NULL;
+        }
+    }
+    if (cache) {
+        // mutable inputs are copied so that later hits compare the original bytes
+        res->cache_data = PyBytes_CheckExact(data) ? new_ref(data) : PyBytes_FromObject(data);
+        if (!res->cache_data) {
+            PyErr_Clear();
+            return res;
+        }
+        res->key = key;
+        res->cached = true;
+        (*self->buffer_cache)[key.hash] = new_ref(res);
+    }
+    return res;
+}
+
+PyObject * Buffer_meth_write(Buffer * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"data", "format", "frequency", "resample_to", "compress", NULL};
+
+    Py_buffer view = {};
+    int format = self->format;
+    int frequency = self->frequency;
+    int resample_to = 0;
+    const char * compress = NULL;
+
+    int args_ok = PyArg_ParseTupleAndKeywords(
+        args,
+        kwargs,
+        "y*|iiiz",
+        keywords,
+        &view,
+        &format,
+        &frequency,
+        &resample_to,
+        &compress
+    );
+
+    if (!args_ok) {
+        return NULL;
+    }
+
+    if (!scheduler_reap(self->ctx)) {
+        PyBuffer_Release(&view);
+        return NULL;
+    }
+
+    if (self->bound != 0) {
+        PyBuffer_Release(&view);
+        PyErr_BadInternalCall();
+        return NULL;
+    }
+
+    if (self->cached) {
+        PyBuffer_Release(&view);
+        PyErr_Format(PyExc_ValueError, "cannot write to a cached buffer, every caller with the same data shares it");
+        return NULL;
+    }
+
+    if (compress && (strcmp(compress, "ima4") || !format_channels(format))) {
+        PyBuffer_Release(&view);
+        PyErr_Format(PyExc_ValueError, "cannot compress format 0x%x as %s", format, compress);
+        return NULL;
+    }
+
+    const void * data = view.buf;
+    int size = (int)view.len;
+    void * resampled = NULL;
+
+    if (resample_to && resample_to != frequency) {
+        int channels = format_channels(format);
+        int bits = format_bits(format);
+        if (!channels || frequency <= 0 || resample_to <= 0) {
+            PyBuffer_Release(&view);
+            PyErr_Format(PyExc_ValueError, "cannot resample format 0x%x from %d to %d", format, frequency, resample_to);
+            return NULL;
+        }
+        int frame_size = channels * bits / 8;
+        int frames = size / frame_size;
+        int dst_frames = resampled_frames(frames, frequency, resample_to);
+        resampled = malloc((size_t)dst_frames * frame_size);
+        bool ok = resampled != NULL;
+        if (ok) {
+            Py_BEGIN_ALLOW_THREADS
+            ok = resample(resampled, dst_frames, data, frames, channels, bits, frequency, resample_to);
+            Py_END_ALLOW_THREADS
+        }
+        if (!ok) {
+            free(resampled);
+            PyBuffer_Release(&view);
+            return PyErr_NoMemory();
+        }
+        data = resampled;
+        size = dst_frames * frame_size;
+        frequency = resample_to;
+    }
+
+    void * encoded = NULL;
+
+    if (compress) {
+        int channels = format_channels(format);
+        int bits = format_bits(format);
+        int frames = size / (channels * bits / 8);
+        int encoded_size = ima4_size(frames, channels);
+        size_t converted_size = bits != 16 ? sizeof(short) * frames * channels : 0;
+        encoded = malloc(encoded_size + converted_size);
+        if (!encoded) {
+            free(resampled);
+            PyBuffer_Release(&view);
+            return PyErr_NoMemory();
+        }
+        Py_BEGIN_ALLOW_THREADS
+        const short * samples = (const short *)data;
+        if (bits != 16) {
+            short * converted = (short *)((char *)encoded + encoded_size);
+            samples_to_int16(converted, data, (long long)frames * channels, bits);
+            samples = converted;
+        }
+        ima4_encode((unsigned char *)encoded, samples, frames, channels);
+        Py_END_ALLOW_THREADS
+        data = encoded;
+        size = encoded_size;
+        format = channels == 1 ? AL_FORMAT_MONO_IMA4 : AL_FORMAT_STEREO_IMA4;
+    }
+
+    bool ok = al_call(self->ctx, BufferData, self->alo, format, data, size, frequency);
+    bool converted = data != view.buf;
+    free(resampled);
+    free(encoded);
+
+    if (ok) {
+        buffer_detach_source(self);
+        buffer_clear_regions(self);
+        buffer_set_resident(self, false);
+        self->format = format;
+        self->frequency = frequency;
+        self->size = size;
+        self->last_use = ++self->ctx->use_clock;
+        buffer_set_resident(self, true);
+        if (self->ctx->memory_budget && !converted && PyBytes_CheckExact(view.obj)) {
+            self->source_owner = new_ref(view.obj);
+            self->source_data = PyBytes_AS_STRING(view.obj);
+        }
+    }
+
+    PyBuffer_Release(&view);
+    if (!ok || !residency_enforce(self->ctx)) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+bool buffer_generate(Buffer * self, const char * kind_name, double duration, double tone, PyObject * end_tone, float amplitude, unsigned seed) {
+    int kind = generator_kind(kind_name);
+    if (kind < 0) {
+        PyErr_Format(PyExc_ValueError, "invalid kind %s", kind_name);
+        return false;
+    }
+
+    int channels = format_channels(self->format);
+    int bits = format_bits(self->format);
+    if (!(duration >= 0.0)) {
+        PyErr_Format(PyExc_ValueError, "duration must not be negative");
+        return false;
+    }
+
+    if (!channels || self->frequency <= 0) {
+        PyErr_Format(PyExc_ValueError, "cannot generate format 0x%x at %d", self->format, self->frequency);
+        return false;
+    }
+
+    if (duration * self->frequency * channels * bits / 8 > INT_MAX) {
+        PyErr_Format(PyExc_ValueError, "duration is too long for format 0x%x at %d", self->format, self->frequency);
+        return false;
+    }
+
+    if (!scheduler_reap(self->ctx)) {
+        return false;
+    }
+
+    if (self->bound != 0) {
+        PyErr_BadInternalCall();
+        return false;
+    }
+
+    if (self->cached) {
+        PyErr_Format(PyExc_ValueError, "cannot fill a cached buffer, every caller with the same data shares it");
+        return false;
+    }
+
+    double sweep_end = end_tone != Py_None ? PyFloat_AsDouble(end_tone) : tone;
+    if (PyErr_Occurred()) {
+        return false;
+    }
+
+    int frames = (int)(duration * self->frequency);
+    int size = (int)((long long)frames * channels * bits / 8);
+    size_t mono_size = sizeof(float) * frames;
+    size_t interleaved_size = channels > 1 ? sizeof(float) * frames * channels : 0;
+
+    char * arena = scratch_acquire(self->ctx, mono_size + interleaved_size + size);
+    if (!arena) {
+        PyErr_NoMemory();
+        return false;
+    }
+
+    float * mono = (float *)arena;
+    float * interleaved = channels > 1 ? (float *)(arena + mono_size) : mono;
+    char * samples = arena + mono_size + interleaved_size;
+    int frequency = self->frequency;
+
+    Py_BEGIN_ALLOW_THREADS
+    generate(mono, frames, kind, frequency, tone, sweep_end, amplitude, seed);
+    if (channels > 1) {
+        interleave_mono(interleaved, mono, frames, channels);
+    }
+    float_to_samples(samples, interleaved, (long long)frames * channels, bits);
+    Py_END_ALLOW_THREADS
+
+    bool ok = al_call(self->ctx, BufferData, self->alo, self->format, samples, size, self->frequency);
+    scratch_release(self->ctx, arena);
+    if (!ok) {
+        return false;
+    }
+    buffer_detach_source(self);
+    buffer_clear_regions(self);
+    buffer_set_resident(self, false);
+    self->size = size;
+    self->last_use = ++self->ctx->use_clock;
+    buffer_set_resident(self, true);
+    return residency_enforce(self->ctx);
+}
+
+PyObject * Buffer_meth_fill(Buffer * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"kind", "duration", "tone", "end_tone", "amplitude", "seed", NULL};
+
+    const char * kind = NULL;
+    double duration = 1.0;
+    double tone = 440.0;
+    PyObject * end_tone = Py_None;
+    float amplitude = 1.0f;
+    unsigned seed = 0;
+
+    int args_ok = PyArg_ParseTupleAndKeywords(
+        args,
+        kwargs,
+        "s|ddOfI",
+        keywords,
+        &kind,
+        &duration,
+        &tone,
+        &end_tone,
+        &amplitude,
+        &seed
+    );
+
+    if (!args_ok) {
+        return NULL;
+    }
+
+    if (!buffer_generate(self, kind, duration, tone, end_tone, amplitude, seed)) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+Buffer * Context_meth_generate(Context * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"kind", "duration", "tone", "end_tone", "amplitude", "seed", "format", "frequency", NULL};
+
+    const char * kind = NULL;
+    double duration = 1.0;
+    double tone = 440.0;
+    PyObject * end_tone = Py_None;
+    float amplitude = 1.0f;
+    unsigned seed = 0;
+    int format = AL_FORMAT_MONO16;
+    int frequency = self->device_frequency ? self->device_frequency : 44100;
+
+    int args_ok = PyArg_ParseTupleAndKeywords(
+        args,
+        kwargs,
+        "s|ddOfIii",
+        keywords,
+        &kind,
+        &duration,
+        &tone,
+        &end_tone,
+        &amplitude,
+        &seed,
+        &format,
+        &frequency
+    );
+
+    if (!args_ok) {
+        return NULL;
+    }
+
+    PyObject * buffer_kwargs = Py_BuildValue("{sisi}", "format", format, "frequency", frequency);
+    Buffer * res = Context_meth_buffer(self, empty_tuple, buffer_kwargs);
+    Py_DECREF(buffer_kwargs);
+    if (!res) {
+        return NULL;
+    }
+
+    if (!buffer_generate(res, kind, duration, tone, end_tone, amplitude, seed)) {
+        object_unlink(res);
+        Py_DECREF(res);
+        return NULL;
+    }
+    return res;
+}
+
+struct MixInput {
+    Py_buffer view;
+    PyObject * owner;
+    void * resampled;
+    const void * data;
+    int channels;
+    int bits;
+    int frames;
+    int offset;
+    float left;
+    float right;
+};
+
+// Inputs are Buffers that retain their PCM or raw bytes in the given format.
+// OpenAL cannot read buffer contents back, so only bank clips and Buffers
+// written from bytes under a memory_budget are accepted. Generated, mixed,
+// resampled and compressed Buffers are rejected. A Buffer input at another
+// frequency is resampled to the output frequency.
+
+Buffer * Context_meth_mix(Context * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"inputs", "gains", "offsets", "pans", "format", "frequency", NULL};
+
+    PyObject * inputs;
+    PyObject * gains = Py_None;
+    PyObject * offsets = Py_None;
+    PyObject * pans = Py_None;
+    int format = AL_FORMAT_MONO16;
+    int frequency = self->device_frequency ? self->device_frequency : 44100;
+
+    int args_ok = PyArg_ParseTupleAndKeywords(
+        args,
+        kwargs,
+        "O|OOOii",
+        keywords,
+        &inputs,
+        &gains,
+        &offsets,
+        &pans,
+        &format,
+        &frequency
+    );
+
+    if (!args_ok) {
+        return NULL;
+    }
+
+    PyObject * seq = PySequence_Fast(inputs, "inputs must be a sequence");
+    if (!seq) {
+        return NULL;
+    }
+
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(seq);
+    std::vector<MixInput> mix(count);
+    Py_ssize_t acquired = 0;
+    int channels = pans != Py_None ? 2 : 1;
+    int frames = 0;
+    bool ok = true;
+
+    for (Py_ssize_t i = 0; ok && i < count; ++i) {
+        PyObject * input = PySequence_Fast_GET_ITEM(seq, i);
+        MixInput & item = mix[i];
+        item.view.obj = NULL;
+        item.owner = NULL;
+        item.resampled = NULL;
+        if (Py_TYPE(input) == Buffer_type) {
+            Buffer * buffer = (Buffer *)input;
+            item.channels = format_channels(buffer->format);
+            item.bits = format_bits(buffer->format);
+            if (!buffer->source_data || !item.channels) {
+                PyErr_Format(PyExc_ValueError, "input %zd does not retain PCM data, pass bytes, a bank clip or a buffer written under a memory_budget", i);
+                ok = false;
+                break;
+            }
+            // the bytes object or the bank mapping must outlive the mix
+            item.owner = buffer->source_owner ? buffer->source_owner : (PyObject *)buffer->source_bank;
+            Py_INCREF(item.owner);
+            item.data = buffer->source_data;
+            item.frames = buffer->size / (item.channels * item.bits / 8);
+            if (buffer->frequency != frequency && item.frames) {
+                int frame_size = item.channels * item.bits / 8;
+                int dst_frames = resampled_frames(item.frames, buffer->frequency, frequency);
+                item.resampled = malloc((size_t)dst_frames * frame_size);
+                bool resampled = item.resampled != NULL;
+                if (resampled) {
+                    Py_BEGIN_ALLOW_THREADS
+                    resampled = resample(item.resampled, dst_frames, item.data, item.frames, item.channels, item.bits, buffer->frequency, frequency);
+                    Py_END_ALLOW_THREADS
+                }
+                if (!resampled) {
+                    acquired = i + 1;
+                    PyErr_NoMemory();
+                    ok = false;
+                    break;
+                }
+                item.data = item.resampled;
+                item.frames = dst_frames;
+            }
+        } else {
+            item.channels = format_channels(format);
+            item.bits = format_bits(format);
+            if (!item.channels) {
+                PyErr_Format(PyExc_ValueError, "cannot mix format 0x%x", format);
+                ok = false;
+                break;
+            }
+            if (PyObject_GetBuffer(input, &item.view, PyBUF_SIMPLE) < 0) {
+                ok = false;
+                break;
+            }
+            item.data = item.view.buf;
+            item.frames = (int)(item.view.len / (item.channels * item.bits / 8));
+        }
+        acquired = i + 1;
+
+        float gain = (float)py_item(gains, i, 1.0);
+        double offset = py_item(offsets, i, 0.0);
+        float pan = (float)py_item(pans, i, 0.0);
+        if (PyErr_Occurred()) {
+            ok = false;
+            break;
+        }
+        if (offset < 0.0) {
+            PyErr_Format(PyExc_ValueError, "negative offset for input %zd", i);
+            ok = false;
+            break;
+        }
+
+        pan = pan < -1.0f ? -1.0f : pan > 1.0f ? 1.0f : pan;
+        if (item.channels == 2) {
+            item.left = gain * (pan > 0.0f ? 1.0f - pan : 1.0f);
+            item.right = gain * (pan < 0.0f ? 1.0f + pan : 1.0f);
+            channels = 2;
+        } else if (pans != Py_None) {
+            float angle = (pan + 1.0f) * (float)(dsp_pi / 4.0);
+            item.left = gain * cosf(angle);
+            item.right = gain * sinf(angle);
+        } else {
+            item.left = gain;
+            item.right = gain;
+        }
+
+        item.offset = (int)(offset * frequency);
+        if (item.offset + item.frames > frames) {
+            frames = item.offset + item.frames;
+        }
+    }
+
+    Buffer * res = NULL;
+    if (ok) {
+        PyObject * buffer_kwargs = Py_BuildValue("{sisi}", "format", channels == 2 ? AL_FORMAT_STEREO16 : AL_FORMAT_MONO16, "frequency", frequency);
+        res = Context_meth_buffer(self, empty_tuple, buffer_kwargs);
+        Py_DECREF(buffer_kwargs);
+        ok = res != NULL;
+    }
+
+    char * arena = NULL;
+    size_t bed_size = sizeof(float) * frames * channels;
+    int size = frames * channels * (int)sizeof(short);
+    if (ok) {
+        arena = scratch_acquire(self, bed_size + size);
+        if (!arena) {
+            PyErr_NoMemory();
+            ok = false;
+        }
+    }
+
+    if (ok) {
+        float * bed = (float *)arena;
+        char * samples = arena + bed_size;
+        Py_BEGIN_ALLOW_THREADS
+        memset(bed, 0, bed_size);
+        for (Py_ssize_t i = 0; i < count; ++i) {
+            const MixInput & item = mix[i];
+            mix_accumulate(bed + (size_t)item.offset * channels, channels, item.data, item.channels, item.bits, item.frames, item.left, item.right);
+        }
+        float_to_samples(samples, bed, (long long)frames * channels, 16);
+        Py_END_ALLOW_THREADS
+
+        buffer_set_resident(res, false);
+        res->size = size;
+        res->last_use = ++self->use_clock;
+        ok = al_call(self, BufferData, res->alo, res->format, samples, res->size, res->frequency);
+        scratch_release(self, arena);
+        if (ok) {
+            buffer_set_resident(res, true);
+            ok = residency_enforce(self);
+        }
+    }
+
+    for (Py_ssize_t i = 0; i < acquired; ++i) {
+        if (mix[i].view.obj) {
+            PyBuffer_Release(&mix[i].view);
+        }
+        Py_XDECREF(mix[i].owner);
+        free(mix[i].resampled);
+    }
+    Py_DECREF(seq);
+    if (!ok && res) {
+        object_unlink(res);
+        Py_DECREF(res);
+    }
+    return ok ? res : NULL;
+}
+
+// Minimal RIFF/WAVE reader for PCM and IEEE float fmt chunks.
+// Returns 0 when the data is not a WAVE file and -1 when the layout is unsupported.
+
+int wav_parse(const char * ptr, size_t size, int * format, int * frequency, const char ** data, size_t * data_size) {
+    if (size < 12 || memcmp(ptr, "RIFF", 4) || memcmp(ptr + 8, "WAVE", 4)) {
+        return 0;
+    }
+
+    int channels = 0;
+    int bits = 0;
+    int tag = 0;
+    size_t pos = 12;
+    *data = NULL;
+    while (pos + 8 <= size) {
+        unsigned chunk_size;
+        memcpy(&chunk_size, ptr + pos + 4, 4);
+        const char * chunk = ptr + pos + 8;
+        size_t available = size - pos - 8;
+        if (!memcmp(ptr + pos, "fmt ", 4) && chunk_size >= 16 && available >= 16) {
+            unsigned short value;
+            memcpy(&value, chunk, 2);
+            tag = value;
+            memcpy(&value, chunk + 2, 2);
+            channels = value;
+            memcpy(frequency, chunk + 4, 4);
+            memcpy(&value, chunk + 14, 2);
+            bits = value;
+        }
+        if (!memcmp(ptr + pos, "data", 4)) {
+            *data = chunk;
+            *data_size = chunk_size < available ? chunk_size : available;
+            break;
+        }
+        pos += 8 + (size_t)chunk_size + (chunk_size & 1);
+    }
+
+    *format = 0;
+    if (tag == 1 && bits == 8) {
+        *format = channels == 1 ? AL_FORMAT_MONO8 : channels == 2 ? AL_FORMAT_STEREO8 : 0;
+    }
+    if (tag == 1 && bits == 16) {
+        *format = channels == 1 ? AL_FORMAT_MONO16 : channels == 2 ? AL_FORMAT_STEREO16 : 0;
+    }
+    if (tag == 3 && bits == 32) {
+        *format = channels == 1 ? AL_FORMAT_MONO_FLOAT32 : channels == 2 ? AL_FORMAT_STEREO_FLOAT32 : 0;
+    }
+    return *format && *data && *frequency > 0 ? 1 : -1;
+}
+
+struct LoadJob {
+    std::string path;
+    Py_buffer view;
+    char * mapped;
+    size_t mapped_size;
+    const char * data;
+    size_t size;
+    int format;
+    int frequency;
+    std::vector<char> converted;
+    std::string error;
+};
+
+void load_job_run(LoadJob & job, int resample_to) {
+    if (!job.view.obj) {
+        job.mapped = map_file(job.path.c_str(), &job.mapped_size);
+        if (!job.mapped) {
+            job.error = "cannot map " + job.path;
+            return;
+        }
+        job.data = job.mapped;
+        job.size = job.mapped_size;
+    }
+
+    const char * data;
+    size_t size;
+    int parsed = wav_parse(job.data, job.size, &job.format, &job.frequency, &data, &size);
+    if (parsed < 0) {
+        job.error = "unsupported wave layout";
+        return;
+    }
+    if (parsed > 0) {
+        job.data = data;
+        job.size = size;
+    }
+
+    if (resample_to && resample_to != job.frequency) {
+        int channels = format_channels(job.format);
+        int bits = format_bits(job.format);
+        if (!channels || job.frequency <= 0) {
+            job.error = "cannot resample this format";
+            return;
+        }
+        int frame_size = channels * bits / 8;
+        int frames = (int)(job.size / frame_size);
+        int dst_frames = resampled_frames(frames, job.frequency, resample_to);
+        job.converted.resize((size_t)dst_frames * frame_size);
+        if (!resample(job.converted.data(), dst_frames, job.data, frames, channels, bits, job.frequency, resample_to)) {
+            job.error = "out of memory";
+            return;
+        }
+        job.data = job.converted.data();
+        job.size = job.converted.size();
+        job.frequency = resample_to;
+    }
+}
+
+// Files are mapped, parsed and resampled on worker threads that take the next
+// pending job from a shared counter. The uploads then happen on the calling
+// thread with a single GenBuffers for the whole batch.
+
+PyObject * Context_meth_load_many(Context * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"items", "format", "frequency", "resample_to", "workers", NULL};
+
+    PyObject * items;
+    int format = AL_FORMAT_MONO16;
+    int frequency = self->device_frequency ? self->device_frequency : 44100;
+    int resample_to = 0;
+    int workers = 0;
+
+    int args_ok = PyArg_ParseTupleAndKeywords(
+        args,
+        kwargs,
+        "O|iiii",
+        keywords,
+        &items,
+        &format,
+        &frequency,
+        &resample_to,
+        &workers
+    );
+
+    if (!args_ok) {
+        return NULL;
+    }
+
+    PyObject * seq = PySequence_Fast(items, "items must be a sequence");
+    if (!seq) {
+        return NULL;
+    }
+
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(seq);
+    std::vector<LoadJob> jobs(count);
+    bool ok = true;
+
+    for (Py_ssize_t i = 0; ok && i < count; ++i) {
+        PyObject * item = PySequence_Fast_GET_ITEM(seq, i);
+        LoadJob & job = jobs[i];
+        job.view.obj = NULL;
+        job.mapped = NULL;
+        job.mapped_size = 0;
+        job.format = format;
+        job.frequency = frequency;
+        if (PyUnicode_Check(item)) {
+            const char * path = PyUnicode_AsUTF8(item);
+            ok = path != NULL;
+            job.path = path ? path : "";
+        } else if (PyObject_GetBuffer(item, &job.view, PyBUF_SIMPLE) == 0) {
+            job.data = (const char *)job.view.buf;
+            job.size = job.view.len;
+        } else {
+            job.view.obj = NULL;
+            ok = false;
+        }
+    }
+
+    if (ok) {
+        int threads = workers > 0 ? workers : (int)std::thread::hardware_concurrency();
+        threads = threads < 1 ? 1 : threads > count ? (int)count : threads;
+        std::atomic<Py_ssize_t> next(0);
+
+        Py_BEGIN_ALLOW_THREADS
+        std::vector<std::thread> pool;
+        for (int t = 0; t < threads; ++t) {
+            pool.push_back(std::thread([&jobs, &next, count, resample_to]() {
+                for (Py_ssize_t i = next++; i < count; i = next++) {
+                    load_job_run(jobs[i], resample_to);
+                }
+            }));
+        }
+        for (int t = 0; t < threads; ++t) {
+            pool[t].join();
+        }
+        Py_END_ALLOW_THREADS
+
+        for (Py_ssize_t i = 0; i < count; ++i) {
+            if (!jobs[i].error.empty()) {
+                PyErr_Format(PyExc_ValueError, "item %zd: %s", i, jobs[i].error.c_str());
+                ok = false;
+                break;
+            }
+        }
+    }
+
+    std::vector<ALuint> names(count);
+    if (ok && count) {
+        ok = al_call(self, GenBuffers, (ALsizei)count, names.data());
+    }
+
+    for (Py_ssize_t i = 0; ok && i < count; ++i) {
+        ok = al_call(self, BufferData, names[i], jobs[i].format, jobs[i].data, (ALsizei)jobs[i].size, jobs[i].frequency);
+        if (!ok) {
+            self->al.DeleteBuffers((ALsizei)count, names.data());
+        }
+    }
+
+    PyObject * res = ok ? PyList_New(count) : NULL;
+    for (Py_ssize_t i = 0; ok && i < count; ++i) {
+        Buffer * buffer = buffer_link(self, Buffer_type, jobs[i].format, jobs[i].frequency);
+        buffer->alo = names[i];
+        buffer->size = (int)jobs[i].size;
+        buffer->resident = false;
+        buffer_set_resident(buffer, true);
+        PyList_SET_ITEM(res, i, (PyObject *)buffer);
+    }
+
+    for (Py_ssize_t i = 0; i < count; ++i) {
+        if (jobs[i].view.obj) {
+            PyBuffer_Release(&jobs[i].view);
+        }
+        if (jobs[i].mapped) {
+            unmap_file(jobs[i].mapped, jobs[i].mapped_size);
+        }
+    }
+    Py_DECREF(seq);
+
+    if (!ok || !residency_enforce(self)) {
+        return NULL;
+    }
+    return res;
+}
+
+int buffer_frames(Buffer * self) {
+    int channels = format_channels(self->format);
+    if (channels) {
+        return self->size / (channels * format_bits(self->format) / 8);
+    }
+    if (self->format == AL_FORMAT_MONO_IMA4 || self->format == AL_FORMAT_STEREO_IMA4) {
+        int block_size = (self->format == AL_FORMAT_MONO_IMA4 ? 1 : 2) * (4 + (ima4_block_frames - 1) / 2);
+        return self->size / block_size * ima4_block_frames;
+    }
+    return -1;
+}
+
+bool buffer_add_region(Buffer * self, const char * name, int start, int end) {
+    int frames = buffer_frames(self);
+    if (start < 0 || end <= start || (frames >= 0 && end > frames)) {
+        PyErr_Format(PyExc_ValueError, "invalid region %s from %d to %d", name, start, end);
+        return false;
+    }
+    if (!self->regions) {
+        self->regions = new std::unordered_map<std::string, Region>();
+    }
+    Region region = {start, end};
+    (*self->regions)[name] = region;
+    return true;
+}
+
+PyObject * Buffer_meth_region(Buffer * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"name", "start", "end", NULL};
+
+    const char * name = NULL;
+    double start = 0.0;
+    double end = 0.0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sdd", keywords, &name, &start, &end)) {
+        return NULL;
+    }
+
+    if (!buffer_add_region(self, name, (int)(start * self->frequency + 0.5), (int)(end * self->frequency + 0.5))) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject * Buffer_get_regions(Buffer * self, void * closure) {
+    PyObject * res = PyDict_New();
+    if (self->regions) {
+        for (std::unordered_map<std::string, Region>::iterator it = self->regions->begin(); it != self->regions->end(); ++it) {
+            double start = (double)it->second.start / self->frequency;
+            double end = (double)it->second.end / self->frequency;
+            PyObject * value = Py_BuildValue("(dd)", start, end);
+            PyDict_SetItemString(res, it->first.c_str(), value);
+            Py_DECREF(value);
+        }
+    }
+    return res;
+}
+
+// Packs many small clips into one buffer, one upload and one AL name,
+// and records each clip as a named region.
+
+Buffer * Context_meth_atlas(Context * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"clips", "format", "frequency", NULL};
+
+    PyObject * clips;
+    int format = AL_FORMAT_MONO16;
+    int frequency = self->device_frequency ? self->device_frequency : 44100;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!|ii", keywords, &PyDict_Type, &clips, &format, &frequency)) {
+        return NULL;
+    }
+
+    int channels = format_channels(format);
+    if (!channels) {
+        PyErr_Format(PyExc_ValueError, "cannot pack format 0x%x", format);
+        return NULL;
+    }
+    int frame_size = channels * format_bits(format) / 8;
+
+    Py_ssize_t pos = 0;
+    PyObject * name;
+    PyObject * data;
+    Py_ssize_t total = 0;
+    while (PyDict_Next(clips, &pos, &name, &data)) {
+        Py_buffer view = {};
+        if (!PyUnicode_Check(name) || PyObject_GetBuffer(data, &view, PyBUF_SIMPLE) < 0) {
+            if (!PyErr_Occurred()) {
+                PyErr_Format(PyExc_ValueError, "clip names must be strings");
+            }
+            return NULL;
+        }
+        total += view.len / frame_size * frame_size;
+        PyBuffer_Release(&view);
+    }
+
+    PyObject * packed = PyBytes_FromStringAndSize(NULL, total);
+    if (!packed) {
+        return NULL;
+    }
+
+    std::vector<std::pair<const char *, Region> > regions;
+    char * ptr = PyBytes_AS_STRING(packed);
+    Py_ssize_t offset = 0;
+    pos = 0;
+    while (PyDict_Next(clips, &pos, &name, &data)) {
+        Py_buffer view = {};
+        if (PyObject_GetBuffer(data, &view, PyBUF_SIMPLE) < 0) {
+            Py_DECREF(packed);
+            return NULL;
+        }
+        Py_ssize_t size = view.len / frame_size * frame_size;
+        memcpy(ptr + offset, view.buf, size);
+        PyBuffer_Release(&view);
+        Region region = {(int)(offset / frame_size), (int)((offset + size) / frame_size)};
+        regions.push_back(std::make_pair(PyUnicode_AsUTF8(name), region));
+        offset += size;
+    }
+
+    PyObject * buffer_kwargs = Py_BuildValue("{sisi}", "format", format, "frequency", frequency);
+    Buffer * res = Context_meth_buffer(self, empty_tuple, buffer_kwargs);
+    Py_DECREF(buffer_kwargs);
+    if (!res) {
+        Py_DECREF(packed);
+        return NULL;
+    }
+
+    PyObject * call = PyObject_CallMethod((PyObject *)res, "write", "Oii", packed, format, frequency);
+    Py_XDECREF(call);
+    Py_DECREF(packed);
+    if (!call) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < regions.size(); ++i) {
+        if (regions[i].second.end > regions[i].second.start) {
+            if (!buffer_add_region(res, regions[i].first, regions[i].second.start, regions[i].second.end)) {
+                return NULL;
+            }
+        }
+    }
+    return res;
+}
+
+PyMethodDef Buffer_methods[] = {
+    {"write", (PyCFunction)Buffer_meth_write, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"fill", (PyCFunction)Buffer_meth_fill, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"region", (PyCFunction)Buffer_meth_region, METH_VARARGS | METH_KEYWORDS, NULL},
+    {},
+};
+
+PyGetSetDef Buffer_getset[] = {
+    {"regions", (getter)Buffer_get_regions, NULL, NULL, NULL},
+    {},
+};
+
+PyMemberDef Buffer_members[] = {
+    {"format", T_INT, offsetof(Buffer, format), READONLY, NULL},
+    {"frequency", T_INT, offsetof(Buffer, frequency), READONLY, NULL},
+    {"size", T_INT, offsetof(Buffer, size), READONLY, NULL},
+    {"alo", T_INT, offsetof(Buffer, alo), READONLY, NULL},
+    {"resident", T_BOOL, offsetof(Buffer, resident), READONLY, NULL},
+    {},
+};
+
+PyType_Slot Buffer_slots[] = {
+    {Py_tp_methods, Buffer_methods},
+    {Py_tp_getset, Buffer_getset},
+    {Py_tp_members, Buffer_members},
+    {Py_tp_dealloc, (void *)BaseObject_dealloc},
+    {},
+};
+
+// The mixer pulls from the ring. Missing bytes are filled with silence and
+// counted as an underrun instead of returning short, which would end the stream.
+
+ALsizei AL_APIENTRY stream_ring_pull(ALvoid * userptr, ALvoid * sampledata, ALsizei numbytes) {
+    StreamRing * ring = (StreamRing *)userptr;
+    char * dst = (char *)sampledata;
+    unsigned long long read = ring->read.load(std::memory_order_relaxed);
+    unsigned long long available = ring->write.load(std::memory_order_acquire) - read;
+    unsigned long long count = available < (unsigned long long)numbytes ? available : (unsigned long long)numbytes;
+    unsigned long long start = read & (ring->capacity - 1);
+    unsigned long long first = count < ring->capacity - start ? count : ring->capacity - start;
+    memcpy(dst, ring->data + start, first);
+    memcpy(dst + first, ring->data, count - first);
+    ring->read.store(read + count, std::memory_order_release);
+    if (count < (unsigned long long)numbytes) {
+        memset(dst + count, ring->silence, numbytes - count);
+        ring->underruns.fetch_add(1, std::memory_order_relaxed);
+    }
+    return numbytes;
+}
+
+CallbackBuffer * Context_meth_callback_buffer(Context * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"format", "frequency", "capacity", NULL};
+
+    int format = AL_FORMAT_MONO16;
+    int frequency = 0;
+    int capacity = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|iii", keywords, &format, &frequency, &capacity)) {
+        return NULL;
+    }
+
+    if (context_ready(self, -1.0) < 0) {
+        return NULL;
+    }
+
+    if (!self->al.BufferCallbackSOFT) {
+        PyErr_Format(error_type, "AL_SOFT_callback_buffer is not supported");
+        return NULL;
+    }
+
+    int channels = format_channels(format);
+    if (!channels || capacity < 0) {
+        PyErr_Format(PyExc_ValueError, "invalid callback buffer format 0x%x", format);
+        return NULL;
+    }
+
+    if (!frequency) {
+        frequency = self->device_frequency ? self->device_frequency : 44100;
+    }
+
+    // half a second by default, rounded up to a power of two
+    unsigned long long size = capacity ? capacity : frequency * channels * format_bits(format) / 16;
+    unsigned long long ring_size = 1024;
+    while (ring_size < size) {
+        ring_size *= 2;
+    }
+
+    StreamRing * ring = new StreamRing();
+    ring->data = (char *)calloc(ring_size, 1);
+    if (!ring->data) {
+        delete ring;
+        return (CallbackBuffer *)PyErr_NoMemory();
+    }
+    ring->capacity = ring_size;
+    ring->write = 0;
+    ring->read = 0;
+    ring->underruns = 0;
+    ring->silence = format_bits(format) == 8 ? 128 : 0;
+
+    CallbackBuffer * res = (CallbackBuffer *)buffer_link(self, CallbackBuffer_type, format, frequency);
+    res->ring = ring;
+    res->reserved = NULL;
+    res->reserved_size = 0;
+    res->exports = 0;
+
+    if (!al_call(self, GenBuffers, 1, (ALuint *)&res->alo)) {
+        res->alo = 0;
+    } else if (!al_call(self, BufferCallbackSOFT, res->alo, format, frequency, stream_ring_pull, (ALvoid *)ring)) {
+        al_call(self, DeleteBuffers, 1, (ALuint *)&res->alo);
+        res->alo = 0;
+    }
+    if (!res->alo) {
+        free(ring->data);
+        delete ring;
+        res->ring = NULL;
+        object_unlink(res);
+        Py_DECREF(res);
+        return NULL;
+    }
+    return res;
+}
+
+StreamRing * callback_buffer_ring(CallbackBuffer * self) {
+    if (!self->ring) {
+        PyErr_Format(PyExc_ValueError, "callback buffer was released");
+    }
+    return self->ring;
+}
+
+PyObject * CallbackBuffer_meth_reserve(CallbackBuffer * self, PyObject * args) {
+    Py_ssize_t limit = -1;
+
+    if (!PyArg_ParseTuple(args, "|n", &limit)) {
+        return NULL;
+    }
+
+    StreamRing * ring = callback_buffer_ring(self);
+    if (!ring) {
+        return NULL;
+    }
+    unsigned long long write = ring->write.load(std::memory_order_relaxed);
+    unsigned long long space = ring->capacity - (write - ring->read.load(std::memory_order_acquire));
+    unsigned long long start = write & (ring->capacity - 1);
+    unsigned long long size = space < ring->capacity - start ? space : ring->capacity - start;
+    if (limit >= 0 && (unsigned long long)limit < size) {
+        size = limit;
+    }
+    self->reserved = ring->data + start;
+    self->reserved_size = (Py_ssize_t)size;
+    return PyMemoryView_FromObject((PyObject *)self);
+}
+
+PyObject * CallbackBuffer_meth_commit(CallbackBuffer * self, PyObject * args) {
+    Py_ssize_t size = 0;
+
+    if (!PyArg_ParseTuple(args, "n", &size)) {
+        return NULL;
+    }
+
+    StreamRing * ring = callback_buffer_ring(self);
+    if (!ring) {
+        return NULL;
+    }
+    unsigned long long write = ring->write.load(std::memory_order_relaxed);
+    unsigned long long space = ring->capacity - (write - ring->read.load(std::memory_order_acquire));
+    if (size < 0 || (unsigned long long)size > space) {
+        PyErr_Format(PyExc_ValueError, "cannot commit %zd bytes with %llu bytes free", size, space);
+        return NULL;
+    }
+    ring->write.store(write + size, std::memory_order_release);
+    Py_RETURN_NONE;
+}
+
+PyObject * CallbackBuffer_meth_write(CallbackBuffer * self, PyObject * args) {
+    Py_buffer view = {};
+
+    if (!PyArg_ParseTuple(args, "y*", &view)) {
+        return NULL;
+    }
+
+    StreamRing * ring = callback_buffer_ring(self);
+    if (!ring) {
+        PyBuffer_Release(&view);
+        return NULL;
+    }
+    unsigned long long write = ring->write.load(std::memory_order_relaxed);
+    unsigned long long space = ring->capacity - (write - ring->read.load(std::memory_order_acquire));
+    unsigned long long count = (unsigned long long)view.len < space ? view.len : space;
+    unsigned long long start = write & (ring->capacity - 1);
+    unsigned long long first = count < ring->capacity - start ? count : ring->capacity - start;
+    memcpy(ring->data + start, view.buf, first);
+    memcpy(ring->data, (char *)view.buf + first, count - first);
+    ring->write.store(write + count, std::memory_order_release);
+    PyBuffer_Release(&view);
+    return PyLong_FromUnsignedLongLong(count);
+}
+
+PyObject * CallbackBuffer_meth_unsupported(CallbackBuffer * self, PyObject * args, PyObject * kwargs) {
+    PyErr_Format(PyExc_TypeError, "callback buffers are filled through write, reserve and commit");
+    return NULL;
+}
+
+int CallbackBuffer_getbuffer(CallbackBuffer * self, Py_buffer * view, int flags) {
+    if (!callback_buffer_ring(self)) {
+        view->obj = NULL;
+        return -1;
+    }
+    if (PyBuffer_FillInfo(view, (PyObject *)self, self->reserved, self->reserved_size, 0, flags) < 0) {
+        return -1;
+    }
+    self->exports += 1;
+    return 0;
+}
+
+void CallbackBuffer_releasebuffer(CallbackBuffer * self, Py_buffer * view) {
+    self->exports -= 1;
+}
+
+PyObject * CallbackBuffer_get_queued(CallbackBuffer * self, void * closure) {
+    StreamRing * ring = callback_buffer_ring(self);
+    if (!ring) {
+        return NULL;
+    }
+    return PyLong_FromUnsignedLongLong(ring->write.load() - ring->read.load());
+}
+
+PyObject * CallbackBuffer_get_underruns(CallbackBuffer * self, void * closure) {
+    StreamRing * ring = callback_buffer_ring(self);
+    if (!ring) {
+        return NULL;
+    }
+    return PyLong_FromUnsignedLongLong(ring->underruns.load());
+}
+
+PyObject * CallbackBuffer_get_capacity(CallbackBuffer * self, void * closure) {
+    StreamRing * ring = callback_buffer_ring(self);
+    if (!ring) {
+        return NULL;
+    }
+    return PyLong_FromUnsignedLongLong(ring->capacity);
+}
+
+PyMethodDef CallbackBuffer_methods[] = {
+    {"reserve", (PyCFunction)CallbackBuffer_meth_reserve, METH_VARARGS, NULL},
+    {"commit", (PyCFunction)CallbackBuffer_meth_commit, METH_VARARGS, NULL},
+    {"write", (PyCFunction)CallbackBuffer_meth_write, METH_VARARGS, NULL},
+    {"fill", (PyCFunction)CallbackBuffer_meth_unsupported, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"region", (PyCFunction)CallbackBuffer_meth_unsupported, METH_VARARGS | METH_KEYWORDS, NULL},
+    {},
+};
+
+PyGetSetDef CallbackBuffer_getset[] = {
+    {"queued", (getter)CallbackBuffer_get_queued, NULL, NULL, NULL},
+    {"underruns", (getter)CallbackBuffer_get_underruns, NULL, NULL, NULL},
+    {"capacity", (getter)CallbackBuffer_get_capacity, NULL, NULL, NULL},
+    {},
+};
+
+PyType_Slot CallbackBuffer_slots[] = {
+    {Py_tp_methods, CallbackBuffer_methods},
+    {Py_tp_getset, CallbackBuffer_getset},
+    {Py_bf_getbuffer, (void *)CallbackBuffer_getbuffer},
+    {Py_bf_releasebuffer, (void *)CallbackBuffer_releasebuffer},
+    {Py_tp_dealloc, (void *)BaseObject_dealloc},
+    {},
+};
+
+PyType_Spec CallbackBuffer_spec = {"modernal.CallbackBuffer", sizeof(CallbackBuffer), 0, Py_TPFLAGS_DEFAULT, CallbackBuffer_slots};
+
+PyObject * Listener_meth_change(Listener * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {
+        "gain",
+        "position",
+        "velocity",
+        "orientation",
+        NULL,
+    };
+
+    PyObject * gain = Py_None;
+    PyObject * position = Py_None;
+    PyObject * velocity = Py_None;
+    PyObject * orientation = Py_None;
+
+    int args_ok = PyArg_ParseTupleAndKeywords(
+        args,
+        kwargs,
+        "|OOOO",
+        keywords,
+        &gain,
+        &position,
+        &velocity,
+        &orientation
+    );
+
+    if (!args_ok) {
+        return NULL;
+    }
+
+    if (gain != Py_None) {
+        if (!al_call(self->ctx, Listenerf, AL_GAIN, (float)PyFloat_AsDouble(gain))) {
+            return NULL;
+        }
+    }
+    if (position != Py_None) {
+        float value[3] = {};
+        py_floats(value, 3, 3, position);
+        if (!al_call(self->ctx, Listener3f, AL_POSITION, value[0], value[1], value[2])) {
+            return NULL;
+        }
+        memcpy(self->ctx->grid->listener, value, sizeof(value));
+        if (!emitters_refresh(self->ctx)) {
+            return NULL;
+        }
+    }
+    if (velocity != Py_None) {
+        float value[3] = {};
+        py_floats(value, 3, 3, velocity);
+        if (!al_call(self->ctx, Listener3f, AL_VELOCITY, value[0], value[1], value[2])) {
+            return NULL;
+        }
+    }
+    if (orientation != Py_None) {
+        float value[6] = {};
+        py_floats(value, 6, 6, orientation);
+        if (!al_call(self->ctx, Listenerfv, AL_ORIENTATION, value)) {
+            return NULL;
+        }
+    }
+    Py_RETURN_NONE;
+}
+
+PyType_Spec Buffer_spec = {"modernal.Buffer", sizeof(Buffer), 0, Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, Buffer_slots};
+
+PyMethodDef Listener_methods[] = {
+    {"change", (PyCFunction)Listener_meth_change, METH_VARARGS | METH_KEYWORDS, NULL},
+    {},
+};
+
+PyType_Slot Listener_slots[] = {
+    {Py_tp_methods, Listener_methods},
+    {Py_tp_dealloc, (void *)BaseObject_dealloc},
+    {},
+};
+
+PyType_Spec Listener_spec = {"modernal.Listener", sizeof(Listener), 0, Py_TPFLAGS_DEFAULT, Listener_slots};
+
+Source * Context_meth_source(Context * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"buffer", NULL};
+
+    PyObject * buffer = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O!", keywords, Buffer_type, &buffer)) {
+        return NULL;
+    }
+
+    Source * res = PyObject_New(Source, Source_type);
+    res->prev = self;
+    res->next = self->next;
+    self->next->prev = res;
+    self->next = res;
+    res->ctx = self;
+    res->serial = ++self->object_serial;
+
+    res->buffer = NULL;
+    res->playing = false;
+
+    if (!al_call(self, GenSources, 1, (ALuint *)&res->alo)) {
+        return NULL;
+    }
+
+    if (PyObject_SetAttrString((PyObject *)res, "buffer", buffer) < 0) {
+        return NULL;
+    }
+
+    return res;
+}
+
+PyObject * Source_meth_change(Source * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {
+        "loop",
+        "gain",
+        "pitch",
+        "time",
+        "min_gain",
+        "max_gain",
+        "max_distance",
+        "rolloff_factor",
+        "cone_outer_gain",
+        "cone_inner_angle",
+        "cone_outer_angle",
+        "reference_dinstance",
+        "position",
+        "velocity",
+        "direction",
+        NULL,
+    };
+
+    PyObject * loop = Py_None;
+    PyObject * gain = Py_None;
+    PyObject * pitch = Py_None;
+    PyObject * time = Py_None;
+    PyObject * min_gain = Py_None;
+    PyObject * max_gain = Py_None;
+    PyObject * max_distance = Py_None;
     PyObject * rolloff_factor = Py_None;
     PyObject * cone_outer_gain = Py_None;
     PyObject * cone_inner_angle = Py_None;
     PyObject * cone_outer_angle = Py_None;
     PyObject * reference_dinstance = Py_None;
     PyObject * position = Py_None;
-    PyObject * velocity = Py_None;
-    PyObject * direction = Py_None;
+    PyObject * velocity = Py_None;
+    PyObject * direction = Py_None;
+
+    int args_ok = PyArg_ParseTupleAndKeywords(
+        args,
+        kwargs,
+        "|OOOOOOOOOOOOOOO",
+        keywords,
+        &loop,
+        &gain,
+        &pitch,
+        &time,
+        &min_gain,
+        &max_gain,
+        &max_distance,
+        &rolloff_factor,
+        &cone_outer_gain,
+        &cone_inner_angle,
+        &cone_outer_angle,
+        &reference_dinstance,
+        &position,
+        &velocity,
+        &direction
+    );
+
+    if (!args_ok) {
+        return NULL;
+    }
+
+    if (loop != Py_None) {
+        if (!al_call(self->ctx, Sourcei, self->alo, AL_LOOPING, PyObject_IsTrue(loop))) {
+            return NULL;
+        }
+    }
+    if (gain != Py_None) {
+        if (!al_call(self->ctx, Sourcef, self->alo, AL_GAIN, (float)PyFloat_AsDouble(gain))) {
+            return NULL;
+        }
+    }
+    if (pitch != Py_None) {
+        if (!al_call(self->ctx, Sourcef, self->alo, AL_PITCH, (float)PyFloat_AsDouble(pitch))) {
+            return NULL;
+        }
+    }
+    if (time != Py_None) {
+        if (!al_call(self->ctx, Sourcef, self->alo, AL_SEC_OFFSET, (float)PyFloat_AsDouble(time))) {
+            return NULL;
+        }
+    }
+    if (min_gain != Py_None) {
+        if (!al_call(self->ctx, Sourcef, self->alo, AL_MIN_GAIN, (float)PyFloat_AsDouble(min_gain))) {
+            return NULL;
+        }
+    }
+    if (max_gain != Py_None) {
+        if (!al_call(self->ctx, Sourcef, self->alo, AL_MAX_GAIN, (float)PyFloat_AsDouble(max_gain))) {
+            return NULL;
+        }
+    }
+    if (max_distance != Py_None) {
+        if (!al_call(self->ctx, Sourcef, self->alo, AL_MAX_DISTANCE, (float)PyFloat_AsDouble(max_distance))) {
+            return NULL;
+        }
+    }
+    if (rolloff_factor != Py_None) {
+        if (!al_call(self->ctx, Sourcef, self->alo, AL_ROLLOFF_FACTOR, (float)PyFloat_AsDouble(rolloff_factor))) {
+            return NULL;
+        }
+    }
+    if (cone_outer_gain != Py_None) {
+        if (!al_call(self->ctx, Sourcef, self->alo, AL_CONE_OUTER_GAIN, (float)PyFloat_AsDouble(cone_outer_gain))) {
+            return NULL;
+        }
+    }
+    if (cone_inner_angle != Py_None) {
+        if (!al_call(self->ctx, Sourcef, self->alo, AL_CONE_INNER_ANGLE, (float)PyFloat_AsDouble(cone_inner_angle))) {
+            return NULL;
+        }
+    }
+    if (cone_outer_angle != Py_None) {
+        if (!al_call(self->ctx, Sourcef, self->alo, AL_CONE_OUTER_ANGLE, (float)PyFloat_AsDouble(cone_outer_angle))) {
+            return NULL;
+        }
+    }
+    if (reference_dinstance != Py_None) {
+        if (!al_call(self->ctx, Sourcef, self->alo, AL_REFERENCE_DISTANCE, (float)PyFloat_AsDouble(reference_dinstance))) {
+            return NULL;
+        }
+    }
+    if (position != Py_None) {
+        float value[3] = {};
+        py_floats(value, 3, 3, position);
+        if (!al_call(self->ctx, Source3f, self->alo, AL_POSITION, value[0], value[1], value[2])) {
+            return NULL;
+        }
+    }
+    if (velocity != Py_None) {
+        float value[3] = {};
+        py_floats(value, 3, 3, velocity);
+        if (!al_call(self->ctx, Source3f, self->alo, AL_VELOCITY, value[0], value[1], value[2])) {
+            return NULL;
+        }
+    }
+    if (direction != Py_None) {
+        float value[3] = {};
+        py_floats(value, 3, 3, direction);
+        if (!al_call(self->ctx, Source3f, self->alo, AL_DIRECTION, value[0], value[1], value[2])) {
+            return NULL;
+        }
+    }
+
+    Py_RETURN_NONE;
+}
+
+double automation_now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double context_clock(Context * self) {
+    if (self->opened && self->alc.GetInteger64vSOFT) {
+        ALCint64SOFT clock = 0;
+        self->alc.GetInteger64vSOFT(self->device, ALC_DEVICE_CLOCK_SOFT, 1, &clock);
+        return clock * 1e-9;
+    }
+    return automation_now();
+}
+
+void scheduler_run(Scheduler * self) {
+    const std::chrono::steady_clock::duration spin = std::chrono::milliseconds(1);
+    std::unique_lock<std::mutex> guard(self->lock);
+    while (true) {
+        if (self->events.empty()) {
+            self->wake.wait(guard);
+            continue;
+        }
+
+        std::chrono::steady_clock::time_point when = self->events[0].when;
+        for (size_t i = 1; i < self->events.size(); ++i) {
+            when = self->events[i].when < when ? self->events[i].when : when;
+        }
+
+        if (when - std::chrono::steady_clock::now() > spin) {
+            self->wake.wait_until(guard, when - spin);
+            continue;
+        }
+
+        guard.unlock();
+        while (std::chrono::steady_clock::now() < when) {
+            std::this_thread::yield();
+        }
+        guard.lock();
+
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < self->events.size();) {
+            if (self->events[i].when <= now) {
+                if (self->events[i].play) {
+                    self->SourcePlay(self->events[i].source);
+                } else {
+                    self->SourceStop(self->events[i].source);
+                    self->stopped.push_back(self->events[i].source);
+                }
+                self->events[i] = self->events.back();
+                self->events.pop_back();
+            } else {
+                i += 1;
+            }
+        }
+    }
+}
+
+void scheduler_add(Scheduler * self, Context * ctx, double time, int source, bool play) {
+    std::chrono::steady_clock::duration delay = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(time - context_clock(ctx))
+    );
+    ScheduledEvent event = {std::chrono::steady_clock::now() + delay, source, play};
+    std::lock_guard<std::mutex> guard(self->lock);
+    self->events.push_back(event);
+    if (!self->started) {
+        self->started = true;
+        std::thread(scheduler_run, self).detach();
+    }
+    self->wake.notify_one();
+}
+
+void scheduler_cancel(Scheduler * self, int source) {
+    if (!self->started) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(self->lock);
+    for (size_t i = 0; i < self->events.size();) {
+        if (self->events[i].source == source) {
+            self->events[i] = self->events.back();
+            self->events.pop_back();
+        } else {
+            i += 1;
+        }
+    }
+}
+
+// Stops fired by the scheduler thread are applied to the Source objects here,
+// under the GIL, so that playing and the buffer bind count stay accurate.
+
+bool scheduler_reap(Context * self) {
+    Scheduler * scheduler = self->scheduler;
+    std::vector<int> stopped;
+    if (scheduler->started) {
+        std::lock_guard<std::mutex> guard(scheduler->lock);
+        stopped.swap(scheduler->stopped);
+    }
+    if (stopped.empty()) {
+        return true;
+    }
+    for (BaseObject * obj = self->next; obj != self; obj = obj->next) {
+        Source * source = (Source *)obj;
+        if (Py_TYPE(obj) != Source_type || !source->playing) {
+            continue;
+        }
+        if (std::find(stopped.begin(), stopped.end(), source->alo) == stopped.end()) {
+            continue;
+        }
+        if (!al_call(self, Sourcei, source->alo, AL_BUFFER, 0)) {
+            return false;
+        }
+        source->buffer->bound -= 1;
+        source->playing = false;
+    }
+    return true;
+}
+
+// Loop points set for a looped region stay on the buffer until a whole-buffer
+// play needs the full range back.
+
+bool buffer_reset_loop(Buffer * self) {
+    if (!self->loop_region) {
+        return true;
+    }
+    if (self->bound) {
+        PyErr_Format(PyExc_ValueError, "cannot play the whole buffer while a looped region of it is playing");
+        return false;
+    }
+    int points[2] = {0, buffer_frames(self)};
+    if (!buffer_make_resident(self) || !al_call(self->ctx, Bufferiv, self->alo, AL_LOOP_POINTS_SOFT, points)) {
+        return false;
+    }
+    self->loop_region = false;
+    return true;
+}
+
+bool source_bind(Source * self, Buffer * buffer, PyObject * kwargs, bool region) {
+    if (!scheduler_reap(self->ctx)) {
+        return false;
+    }
+    if (self->playing) {
+        PyObject * call = PyObject_CallMethod((PyObject *)self, "stop", NULL);
+        Py_XDECREF(call);
+        if (!call) {
+            return false;
+        }
+    }
+    PyObject * call = Source_meth_change(self, empty_tuple, kwargs);
+    Py_XDECREF(call);
+    if (!call) {
+        return false;
+    }
+    if (buffer) {
+        if (PyObject_SetAttrString((PyObject *)self, "buffer", (PyObject *)buffer) < 0) {
+            return false;
+        }
+    }
+    if (!self->buffer) {
+        PyErr_Format(PyExc_ValueError, "no buffer");
+        return false;
+    }
+    if (!region && !buffer_reset_loop(self->buffer)) {
+        return false;
+    }
+    if (!buffer_make_resident(self->buffer)) {
+        return false;
+    }
+    if (!al_call(self->ctx, Sourcei, self->alo, AL_BUFFER, self->buffer->alo)) {
+        return false;
+    }
+    self->buffer->bound += 1;
+    self->playing = true;
+    return residency_enforce(self->ctx);
+}
+
+// A region starts at its AL_SAMPLE_OFFSET. Looped regions use AL_SOFT_loop_points,
+// which are a property of the buffer, so the buffer cannot be playing elsewhere.
+// Other regions are stopped at their end by the scheduler thread.
+
+PyObject * source_play_region(Source * self, Buffer * buffer, PyObject * name, PyObject * kwargs) {
+    Buffer * target = buffer ? buffer : self->buffer;
+    const char * key = PyUnicode_Check(name) ? PyUnicode_AsUTF8(name) : NULL;
+    std::unordered_map<std::string, Region>::iterator it;
+    if (!target || !key || !target->regions || (it = target->regions->find(key)) == target->regions->end()) {
+        PyErr_Format(PyExc_KeyError, "region %R not found", name);
+        return NULL;
+    }
+    Region region = it->second;
+
+    PyObject * loop_arg = kwargs ? PyDict_GetItemString(kwargs, "loop") : NULL;
+    int loop = 0;
+    if (loop_arg && loop_arg != Py_None) {
+        loop = PyObject_IsTrue(loop_arg);
+    } else if (!al_call(self->ctx, GetSourcei, self->alo, AL_LOOPING, &loop)) {
+        return NULL;
+    }
+
+    if (loop) {
+        if (!self->ctx->loop_points) {
+            PyErr_Format(error_type, "looped regions require AL_SOFT_loop_points");
+            return NULL;
+        }
+        if (self->playing) {
+            PyObject * call = PyObject_CallMethod((PyObject *)self, "stop", NULL);
+            Py_XDECREF(call);
+            if (!call) {
+                return NULL;
+            }
+        }
+        if (target->bound) {
+            PyErr_Format(PyExc_ValueError, "cannot loop a region of a buffer that is playing");
+            return NULL;
+        }
+        int points[2] = {region.start, region.end};
+        if (!buffer_make_resident(target) || !al_call(self->ctx, Bufferiv, target->alo, AL_LOOP_POINTS_SOFT, points)) {
+            return NULL;
+        }
+        target->loop_region = true;
+    }
+
+    if (!source_bind(self, buffer, kwargs, true)) {
+        return NULL;
+    }
+    if (!al_call(self->ctx, Sourcei, self->alo, AL_SAMPLE_OFFSET, region.start)) {
+        return NULL;
+    }
+    if (!al_call(self->ctx, SourcePlay, self->alo)) {
+        return NULL;
+    }
+    if (!loop) {
+        float pitch = 1.0f;
+        if (!al_call(self->ctx, GetSourcef, self->alo, AL_PITCH, &pitch)) {
+            return NULL;
+        }
+        double duration = (double)(region.end - region.start) / target->frequency / (pitch > 0.0f ? pitch : 1.0f);
+        scheduler_add(self->ctx->scheduler, self->ctx, context_clock(self->ctx) + duration, self->alo, false);
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject * Source_meth_play(Source * self, PyObject * args, PyObject * kwargs) {
+    Buffer * buffer = NULL;
+
+    if (!PyArg_ParseTuple(args, "|O!", Buffer_type, &buffer)) {
+        return NULL;
+    }
+
+    PyObject * region = kwargs ? PyDict_GetItemString(kwargs, "region") : NULL;
+    if (region) {
+        PyObject * change_kwargs = PyDict_Copy(kwargs);
+        PyDict_DelItemString(change_kwargs, "region");
+        PyObject * res = source_play_region(self, buffer, region, change_kwargs);
+        Py_DECREF(change_kwargs);
+        return res;
+    }
+
+    if (!source_bind(self, buffer, kwargs, false)) {
+        return NULL;
+    }
+    if (!al_call(self->ctx, SourcePlay, self->alo)) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject * Source_meth_play_at(Source * self, PyObject * args, PyObject * kwargs) {
+    double time = 0.0;
+    Buffer * buffer = NULL;
+
+    if (!PyArg_ParseTuple(args, "d|O!", &time, Buffer_type, &buffer)) {
+        return NULL;
+    }
+
+    PyObject * buffer_arg = kwargs ? PyDict_GetItemString(kwargs, "buffer") : NULL;
+    if (buffer_arg && buffer) {
+        PyErr_Format(PyExc_TypeError, "buffer given twice");
+        return NULL;
+    }
+    if (buffer_arg && buffer_arg != Py_None && !PyObject_TypeCheck(buffer_arg, Buffer_type)) {
+        PyErr_Format(PyExc_TypeError, "buffer must be a Buffer");
+        return NULL;
+    }
+    if (buffer_arg && buffer_arg != Py_None) {
+        buffer = (Buffer *)buffer_arg;
+    }
+
+    PyObject * change_kwargs = kwargs ? PyDict_Copy(kwargs) : NULL;
+    if (buffer_arg) {
+        PyDict_DelItemString(change_kwargs, "buffer");
+    }
+    bool bound = source_bind(self, buffer, change_kwargs, false);
+    Py_XDECREF(change_kwargs);
+    if (!bound) {
+        return NULL;
+    }
+
+    // the start time is on the device clock only when the device exposes it
+    Context * ctx = self->ctx;
+    if (ctx->al.SourcePlayAtTimeSOFT && ctx->alc.GetInteger64vSOFT) {
+        if (!al_call(ctx, SourcePlayAtTimeSOFT, self->alo, (ALint64SOFT)(time * 1e9))) {
+            return NULL;
+        }
+    } else {
+        Py_BEGIN_ALLOW_THREADS
+        scheduler_add(ctx->scheduler, ctx, time, self->alo, true);
+        Py_END_ALLOW_THREADS
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject * Source_meth_stop_at(Source * self, PyObject * args) {
+    double time = 0.0;
+
+    if (!PyArg_ParseTuple(args, "d", &time)) {
+        return NULL;
+    }
+
+    Context * ctx = self->ctx;
+    Py_BEGIN_ALLOW_THREADS
+    scheduler_add(ctx->scheduler, ctx, time, self->alo, false);
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
+}
+
+PyObject * Source_meth_stop(Source * self) {
+    scheduler_cancel(self->ctx->scheduler, self->alo);
+    if (!scheduler_reap(self->ctx)) {
+        return NULL;
+    }
+    if (self->playing) {
+        if (!al_call(self->ctx, SourceStop, self->alo)) {
+            return NULL;
+        }
+        if (!al_call(self->ctx, Sourcei, self->alo, AL_BUFFER, 0)) {
+            return NULL;
+        }
+        self->buffer->bound -= 1;
+        self->playing = false;
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject * Source_meth_time(Source * self) {
+    float time = 0.0f;
+    if (!al_call(self->ctx, GetSourcefv, self->alo, AL_SEC_OFFSET, &time)) {
+        return NULL;
+    }
+    return PyFloat_FromDouble(time);
+}
+
+// Returns (samples, nanoseconds, latency) with the offset read as 32.32 fixed point
+// through AL_SOFT_source_latency when available, otherwise as whole samples.
+
+PyObject * source_offset(Source * self) {
+    Context * ctx = self->ctx;
+    ALint64SOFT values[2] = {};
+    if (ctx->al.GetSourcei64vSOFT) {
+        if (!al_call(ctx, GetSourcei64vSOFT, self->alo, AL_SAMPLE_OFFSET_LATENCY_SOFT, values)) {
+            return NULL;
+        }
+    } else {
+        int samples = 0;
+        if (!al_call(ctx, GetSourcei, self->alo, AL_SAMPLE_OFFSET, &samples)) {
+            return NULL;
+        }
+        values[0] = (ALint64SOFT)samples << 32;
+        if (ctx->alc.GetInteger64vSOFT) {
+            ctx->alc.GetInteger64vSOFT(ctx->device, ALC_DEVICE_LATENCY_SOFT, 1, &values[1]);
+        }
+    }
+    long long nanoseconds = 0;
+    if (self->buffer && self->buffer->frequency > 0) {
+        nanoseconds = (long long)(values[0] / 4294967296.0 * 1e9 / self->buffer->frequency);
+    }
+    return Py_BuildValue("(LLL)", (long long)(values[0] >> 32), nanoseconds, (long long)values[1]);
+}
+
+PyObject * Source_meth_offset(Source * self) {
+    return source_offset(self);
+}
+
+float ramp_value(const Ramp & ramp, double u) {
+    switch (ramp.curve) {
+        case curve_smooth: {
+            u = u * u * (3.0 - 2.0 * u);
+            break;
+        }
+        case curve_exponential: {
+            double start = ramp.start > 1e-4f ? ramp.start : 1e-4;
+            double target = ramp.target > 1e-4f ? ramp.target : 1e-4;
+            return u >= 1.0 ? ramp.target : (float)(start * pow(target / start, u));
+        }
+    }
+    return (float)(ramp.start + (ramp.target - ramp.start) * u);
+}
+
+bool path_evaluate(const Path & path, double now, float * position, float * velocity) {
+    const std::vector<Keyframe> & keys = path.keyframes;
+    double duration = keys.back().time;
+    double t = now - path.begin;
+    bool finished = t >= duration && !path.loop;
+    if (path.loop && duration > 0.0) {
+        t = fmod(t, duration);
+    }
+    if (t <= keys[0].time || keys.size() == 1) {
+        memcpy(position, keys[0].position, sizeof(float) * 3);
+        memset(velocity, 0, sizeof(float) * 3);
+        return finished;
+    }
+    size_t i = 1;
+    while (i < keys.size() - 1 && keys[i].time < t) {
+        i += 1;
+    }
+    const Keyframe & a = keys[i - 1];
+    const Keyframe & b = keys[i];
+    double span = b.time - a.time;
+    double u = span > 0.0 ? (t - a.time) / span : 1.0;
+    u = u > 1.0 ? 1.0 : u;
+    for (int k = 0; k < 3; ++k) {
+        position[k] = (float)(a.position[k] + (b.position[k] - a.position[k]) * u);
+        velocity[k] = finished || span <= 0.0 ? 0.0f : (float)((b.position[k] - a.position[k]) / span);
+    }
+    return finished;
+}
+
+void automation_run(Automation * self) {
+    std::unique_lock<std::mutex> guard(self->lock);
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(self->period)
+    );
+    while (true) {
+        while (self->ramps.empty() && self->paths.empty()) {
+            self->wake.wait(guard);
+            next = std::chrono::steady_clock::now();
+        }
+
+        double now = automation_now();
+
+        for (size_t i = 0; i < self->ramps.size();) {
+            const Ramp & ramp = self->ramps[i];
+            double u = ramp.duration > 0.0 ? (now - ramp.begin) / ramp.duration : 1.0;
+            u = u < 0.0 ? 0.0 : u > 1.0 ? 1.0 : u;
+            self->Sourcef(ramp.source, ramp.param, ramp_value(ramp, u));
+            if (u >= 1.0) {
+                self->ramps[i] = self->ramps.back();
+                self->ramps.pop_back();
+            } else {
+                i += 1;
+            }
+        }
+
+        for (size_t i = 0; i < self->paths.size();) {
+            float position[3];
+            float velocity[3];
+            bool finished = path_evaluate(self->paths[i], now, position, velocity);
+            self->Sourcefv(self->paths[i].source, AL_POSITION, position);
+            self->Sourcefv(self->paths[i].source, AL_VELOCITY, velocity);
+            if (finished) {
+                self->paths[i] = self->paths.back();
+                self->paths.pop_back();
+            } else {
+                i += 1;
+            }
+        }
+
+        next += period;
+        self->wake.wait_until(guard, next);
+    }
+}
+
+void automation_start(Automation * self) {
+    if (!self->started) {
+        self->started = true;
+        std::thread(automation_run, self).detach();
+    }
+    self->wake.notify_one();
+}
+
+int source_param(const char * name) {
+    if (!strcmp(name, "gain")) {
+        return AL_GAIN;
+    }
+    if (!strcmp(name, "pitch")) {
+        return AL_PITCH;
+    }
+    if (!strcmp(name, "min_gain")) {
+        return AL_MIN_GAIN;
+    }
+    if (!strcmp(name, "max_gain")) {
+        return AL_MAX_GAIN;
+    }
+    if (!strcmp(name, "max_distance")) {
+        return AL_MAX_DISTANCE;
+    }
+    if (!strcmp(name, "rolloff_factor")) {
+        return AL_ROLLOFF_FACTOR;
+    }
+    if (!strcmp(name, "cone_outer_gain")) {
+        return AL_CONE_OUTER_GAIN;
+    }
+    if (!strcmp(name, "reference_distance")) {
+        return AL_REFERENCE_DISTANCE;
+    }
+    return 0;
+}
+
+int ramp_curve(const char * name) {
+    if (!strcmp(name, "linear")) {
+        return curve_linear;
+    }
+    if (!strcmp(name, "smooth")) {
+        return curve_smooth;
+    }
+    if (!strcmp(name, "exponential")) {
+        return curve_exponential;
+    }
+    return -1;
+}
+
+void automation_cancel(Automation * self, int source, int param) {
+    for (size_t i = 0; i < self->ramps.size();) {
+        if (self->ramps[i].source == source && (!param || self->ramps[i].param == param)) {
+            self->ramps[i] = self->ramps.back();
+            self->ramps.pop_back();
+        } else {
+            i += 1;
+        }
+    }
+    for (size_t i = 0; !param && i < self->paths.size();) {
+        if (self->paths[i].source == source) {
+            self->paths[i] = self->paths.back();
+            self->paths.pop_back();
+        } else {
+            i += 1;
+        }
+    }
+}
+
+// The lock is scoped to end before the GIL is taken back, so the control
+// thread never waits on a Python thread.
+
+void automation_cancel_locked(Automation * self, int source, int param) {
+    Py_BEGIN_ALLOW_THREADS
+    {
+        std::lock_guard<std::mutex> guard(self->lock);
+        automation_cancel(self, source, param);
+    }
+    Py_END_ALLOW_THREADS
+}
+
+PyObject * Source_meth_ramp(Source * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"param", "target", "duration", "curve", NULL};
+
+    const char * param_name = NULL;
+    float target = 0.0f;
+    double duration = 0.0;
+    const char * curve_name = "linear";
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sfd|s", keywords, &param_name, &target, &duration, &curve_name)) {
+        return NULL;
+    }
+
+    int param = source_param(param_name);
+    if (!param) {
+        PyErr_Format(PyExc_ValueError, "invalid param %s", param_name);
+        return NULL;
+    }
+
+    int curve = ramp_curve(curve_name);
+    if (curve < 0) {
+        PyErr_Format(PyExc_ValueError, "invalid curve %s", curve_name);
+        return NULL;
+    }
+
+    float start = 0.0f;
+    if (!al_call(self->ctx, GetSourcef, self->alo, param, &start)) {
+        return NULL;
+    }
+
+    Ramp ramp = {self->alo, param, curve, start, target, automation_now(), duration};
+
+    Automation * automation = self->ctx->automation;
+    Py_BEGIN_ALLOW_THREADS
+    {
+        std::lock_guard<std::mutex> guard(automation->lock);
+        automation_cancel(automation, self->alo, param);
+        automation->ramps.push_back(ramp);
+        automation_start(automation);
+    }
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
+}
+
+PyObject * Source_meth_path(Source * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"keyframes", "loop", NULL};
+
+    PyObject * keyframes = NULL;
+    int loop = false;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|p", keywords, &keyframes, &loop)) {
+        return NULL;
+    }
+
+    PyObject * seq = PySequence_Fast(keyframes, "not iterable");
+    if (!seq) {
+        return NULL;
+    }
+
+    Path path = {self->alo, (bool)loop, automation_now()};
+    int count = (int)PySequence_Fast_GET_SIZE(seq);
+    for (int i = 0; i < count; ++i) {
+        Keyframe key = {};
+        PyObject * position = NULL;
+        if (!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(seq, i), "dO", &key.time, &position)) {
+            break;
+        }
+        if (py_floats(key.position, 3, 3, position) < 0) {
+            break;
+        }
+        if (i && key.time < path.keyframes.back().time) {
+            PyErr_Format(PyExc_ValueError, "keyframes must be sorted by time");
+            break;
+        }
+        path.keyframes.push_back(key);
+    }
+
+    Py_DECREF(seq);
+
+    if (PyErr_Occurred()) {
+        return NULL;
+    }
+
+    if (!count) {
+        PyErr_Format(PyExc_ValueError, "empty path");
+        return NULL;
+    }
+
+    Automation * automation = self->ctx->automation;
+    Py_BEGIN_ALLOW_THREADS
+    {
+        std::lock_guard<std::mutex> guard(automation->lock);
+        for (size_t i = 0; i < automation->paths.size(); ++i) {
+            if (automation->paths[i].source == self->alo) {
+                automation->paths[i] = automation->paths.back();
+                automation->paths.pop_back();
+                break;
+            }
+        }
+        automation->paths.push_back(path);
+        automation_start(automation);
+    }
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
+}
+
+PyObject * Source_meth_cancel(Source * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"param", NULL};
+
+    const char * param_name = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|z", keywords, &param_name)) {
+        return NULL;
+    }
+
+    int param = param_name ? source_param(param_name) : 0;
+    if (param_name && !param) {
+        PyErr_Format(PyExc_ValueError, "invalid param %s", param_name);
+        return NULL;
+    }
+
+    automation_cancel_locked(self->ctx->automation, self->alo, param);
+    Py_RETURN_NONE;
+}
+
+PyObject * Source_get_buffer(Source * self) {
+    if (self->buffer) {
+        return (PyObject *)new_ref(self->buffer);
+    }
+    Py_RETURN_NONE;
+}
+
+int Source_set_buffer(Source * self, PyObject * value) {
+    if (!scheduler_reap(self->ctx)) {
+        return -1;
+    }
+    if (self->playing) {
+        PyErr_BadInternalCall();
+        return -1;
+    }
+    if (value == Py_None) {
+        self->buffer = NULL;
+        return 0;
+    }
+    if (!PyObject_TypeCheck(value, Buffer_type)) {
+        PyErr_BadInternalCall();
+        return -1;
+    }
+    Buffer * buffer = (Buffer *)value;
+    self->buffer = new_ref(buffer);
+    return 0;
+}
+
+// EFX objects are resolved through alGetProcAddress when the device exposes ALC_EXT_EFX.
+// Effect parameters are passed by name and looked up per effect type.
+
+struct EffectParam {
+    int type;
+    const char * name;
+    int param;
+    bool integer;
+};
+
+const EffectParam effect_params[] = {
+    {AL_EFFECT_REVERB, "density", AL_REVERB_DENSITY, false},
+    {AL_EFFECT_REVERB, "diffusion", AL_REVERB_DIFFUSION, false},
+    {AL_EFFECT_REVERB, "gain", AL_REVERB_GAIN, false},
+    {AL_EFFECT_REVERB, "gain_hf", AL_REVERB_GAINHF, false},
+    {AL_EFFECT_REVERB, "decay_time", AL_REVERB_DECAY_TIME, false},
+    {AL_EFFECT_REVERB, "decay_hf_ratio", AL_REVERB_DECAY_HFRATIO, false},
+    {AL_EFFECT_REVERB, "reflections_gain", AL_REVERB_REFLECTIONS_GAIN, false},
+    {AL_EFFECT_REVERB, "reflections_delay", AL_REVERB_REFLECTIONS_DELAY, false},
+    {AL_EFFECT_REVERB, "late_reverb_gain", AL_REVERB_LATE_REVERB_GAIN, false},
+    {AL_EFFECT_REVERB, "late_reverb_delay", AL_REVERB_LATE_REVERB_DELAY, false},
+    {AL_EFFECT_REVERB, "air_absorption_gain_hf", AL_REVERB_AIR_ABSORPTION_GAINHF, false},
+    {AL_EFFECT_REVERB, "room_rolloff_factor", AL_REVERB_ROOM_ROLLOFF_FACTOR, false},
+    {AL_EFFECT_REVERB, "decay_hf_limit", AL_REVERB_DECAY_HFLIMIT, true},
+    {AL_EFFECT_CHORUS, "waveform", AL_CHORUS_WAVEFORM, true},
+    {AL_EFFECT_CHORUS, "phase", AL_CHORUS_PHASE, true},
+    {AL_EFFECT_CHORUS, "rate", AL_CHORUS_RATE, false},
+    {AL_EFFECT_CHORUS, "depth", AL_CHORUS_DEPTH, false},
+    {AL_EFFECT_CHORUS, "feedback", AL_CHORUS_FEEDBACK, false},
+    {AL_EFFECT_CHORUS, "delay", AL_CHORUS_DELAY, false},
+    {AL_EFFECT_ECHO, "delay", AL_ECHO_DELAY, false},
+    {AL_EFFECT_ECHO, "lr_delay", AL_ECHO_LRDELAY, false},
+    {AL_EFFECT_ECHO, "damping", AL_ECHO_DAMPING, false},
+    {AL_EFFECT_ECHO, "feedback", AL_ECHO_FEEDBACK, false},
+    {AL_EFFECT_ECHO, "spread", AL_ECHO_SPREAD, false},
+};
+
+int effect_type(const char * name) {
+    if (!strcmp(name, "reverb")) {
+        return AL_EFFECT_REVERB;
+    }
+    if (!strcmp(name, "chorus")) {
+        return AL_EFFECT_CHORUS;
+    }
+    if (!strcmp(name, "echo")) {
+        return AL_EFFECT_ECHO;
+    }
+    return -1;
+}
+
+int filter_type(const char * name) {
+    if (!strcmp(name, "lowpass")) {
+        return AL_FILTER_LOWPASS;
+    }
+    if (!strcmp(name, "highpass")) {
+        return AL_FILTER_HIGHPASS;
+    }
+    if (!strcmp(name, "bandpass")) {
+        return AL_FILTER_BANDPASS;
+    }
+    return -1;
+}
+
+bool efx_check(Context * self) {
+    if (context_ready(self, -1.0) < 0) {
+        return false;
+    }
+    if (!self->al.GenEffects || !self->al.GenFilters || !self->al.GenAuxiliaryEffectSlots) {
+        PyErr_Format(error_type, "ALC_EXT_EFX is not supported");
+        return false;
+    }
+    return true;
+}
+
+bool effect_apply(EffectSlot * self, PyObject * params) {
+    if (params == Py_None) {
+        return true;
+    }
+
+    if (!PyDict_Check(params)) {
+        PyErr_Format(PyExc_ValueError, "params must be a dict");
+        return false;
+    }
+
+    Py_ssize_t pos = 0;
+    PyObject * key;
+    PyObject * value;
+    while (PyDict_Next(params, &pos, &key, &value)) {
+        const char * name = PyUnicode_Check(key) ? PyUnicode_AsUTF8(key) : NULL;
+        const EffectParam * param = NULL;
+        for (size_t i = 0; name && i < sizeof(effect_params) / sizeof(effect_params[0]); ++i) {
+            if (effect_params[i].type == self->type && !strcmp(effect_params[i].name, name)) {
+                param = &effect_params[i];
+                break;
+            }
+        }
+        if (!param) {
+            PyErr_Format(PyExc_ValueError, "invalid effect parameter %R", key);
+            return false;
+        }
+        if (param->integer) {
+            if (!al_call(self->ctx, Effecti, self->effect, param->param, PyLong_AsLong(value))) {
+                return false;
+            }
+        } else {
+            if (!al_call(self->ctx, Effectf, self->effect, param->param, (float)PyFloat_AsDouble(value))) {
+                return false;
+            }
+        }
+        if (PyErr_Occurred()) {
+            return false;
+        }
+    }
+
+    // the slot keeps a copy of the effect, so it has to be attached again
+    return al_call(self->ctx, AuxiliaryEffectSloti, self->alo, AL_EFFECTSLOT_EFFECT, self->effect);
+}
+
+bool filter_apply(Context * ctx, int filter, int type, float gain, float gain_hf, float gain_lf) {
+    if (!al_call(ctx, Filterf, filter, AL_LOWPASS_GAIN, gain)) {
+        return false;
+    }
+    switch (type) {
+        case AL_FILTER_LOWPASS:
+            return al_call(ctx, Filterf, filter, AL_LOWPASS_GAINHF, gain_hf);
+        case AL_FILTER_HIGHPASS:
+            return al_call(ctx, Filterf, filter, AL_HIGHPASS_GAINLF, gain_lf);
+        case AL_FILTER_BANDPASS:
+            return al_call(ctx, Filterf, filter, AL_BANDPASS_GAINLF, gain_lf) && al_call(ctx, Filterf, filter, AL_BANDPASS_GAINHF, gain_hf);
+    }
+    return true;
+}
+
+EffectSlot * Context_meth_effect_slot(Context * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"effect", "gain", "params", NULL};
+
+    const char * effect = "reverb";
+    float gain = 1.0f;
+    PyObject * params = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|sfO", keywords, &effect, &gain, &params)) {
+        return NULL;
+    }
+
+    int type = effect_type(effect);
+    if (type < 0) {
+        PyErr_Format(PyExc_ValueError, "invalid effect %s", effect);
+        return NULL;
+    }
+
+    if (!efx_check(self)) {
+        return NULL;
+    }
+
+    EffectSlot * res = PyObject_New(EffectSlot, EffectSlot_type);
+    res->prev = self;
+    res->next = self->next;
+    self->next->prev = res;
+    self->next = res;
+    res->ctx = self;
+    res->alo = 0;
+    res->effect = 0;
+    res->type = type;
+    res->gain = gain;
+
+    if (!al_call(self, GenAuxiliaryEffectSlots, 1, (ALuint *)&res->alo)) {
+        return NULL;
+    }
+    if (!al_call(self, GenEffects, 1, (ALuint *)&res->effect)) {
+        return NULL;
+    }
+    if (!al_call(self, Effecti, res->effect, AL_EFFECT_TYPE, type)) {
+        return NULL;
+    }
+    if (!al_call(self, AuxiliaryEffectSlotf, res->alo, AL_EFFECTSLOT_GAIN, gain)) {
+        return NULL;
+    }
+    if (!al_call(self, AuxiliaryEffectSloti, res->alo, AL_EFFECTSLOT_EFFECT, res->effect)) {
+        return NULL;
+    }
+    if (!effect_apply(res, params)) {
+        return NULL;
+    }
+    return res;
+}
+
+PyObject * EffectSlot_meth_change(EffectSlot * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"gain", "params", NULL};
+
+    PyObject * gain = Py_None;
+    PyObject * params = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|OO", keywords, &gain, &params)) {
+        return NULL;
+    }
+
+    if (gain != Py_None) {
+        self->gain = (float)PyFloat_AsDouble(gain);
+        if (!al_call(self->ctx, AuxiliaryEffectSlotf, self->alo, AL_EFFECTSLOT_GAIN, self->gain)) {
+            return NULL;
+        }
+    }
+    if (!effect_apply(self, params)) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+Filter * Context_meth_filter(Context * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"kind", "gain", "gain_hf", "gain_lf", NULL};
+
+    const char * kind = "lowpass";
+    float gain = 1.0f;
+    float gain_hf = 1.0f;
+    float gain_lf = 1.0f;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|sfff", keywords, &kind, &gain, &gain_hf, &gain_lf)) {
+        return NULL;
+    }
+
+    int type = filter_type(kind);
+    if (type < 0) {
+        PyErr_Format(PyExc_ValueError, "invalid filter %s", kind);
+        return NULL;
+    }
+
+    if (!efx_check(self)) {
+        return NULL;
+    }
+
+    Filter * res = PyObject_New(Filter, Filter_type);
+    res->prev = self;
+    res->next = self->next;
+    self->next->prev = res;
+    self->next = res;
+    res->ctx = self;
+    res->alo = 0;
+    res->type = type;
+    res->gain = gain;
+    res->gain_hf = gain_hf;
+    res->gain_lf = gain_lf;
+
+    if (!al_call(self, GenFilters, 1, (ALuint *)&res->alo)) {
+        return NULL;
+    }
+    if (!al_call(self, Filteri, res->alo, AL_FILTER_TYPE, type)) {
+        return NULL;
+    }
+    if (!filter_apply(self, res->alo, type, gain, gain_hf, gain_lf)) {
+        return NULL;
+    }
+    return res;
+}
+
+PyObject * Filter_meth_change(Filter * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"gain", "gain_hf", "gain_lf", NULL};
+
+    PyObject * gain = Py_None;
+    PyObject * gain_hf = Py_None;
+    PyObject * gain_lf = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|OOO", keywords, &gain, &gain_hf, &gain_lf)) {
+        return NULL;
+    }
+
+    if (gain != Py_None) {
+        self->gain = (float)PyFloat_AsDouble(gain);
+    }
+    if (gain_hf != Py_None) {
+        self->gain_hf = (float)PyFloat_AsDouble(gain_hf);
+    }
+    if (gain_lf != Py_None) {
+        self->gain_lf = (float)PyFloat_AsDouble(gain_lf);
+    }
+    if (PyErr_Occurred()) {
+        return NULL;
+    }
+    if (!filter_apply(self->ctx, self->alo, self->type, self->gain, self->gain_hf, self->gain_lf)) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+// Filter parameters are copied into the source when attached, so changing
+// a Filter does not affect sources until it is attached again.
+
+PyObject * Source_meth_send(Source * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"slot", "send", "filter", NULL};
+
+    PyObject * slot = Py_None;
+    int send = 0;
+    PyObject * filter = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|iO", keywords, &slot, &send, &filter)) {
+        return NULL;
+    }
+
+    if (slot != Py_None && Py_TYPE(slot) != EffectSlot_type) {
+        PyErr_Format(PyExc_ValueError, "slot must be an EffectSlot or None");
+        return NULL;
+    }
+
+    if (filter != Py_None && Py_TYPE(filter) != Filter_type) {
+        PyErr_Format(PyExc_ValueError, "filter must be a Filter or None");
+        return NULL;
+    }
+
+    int slot_alo = slot != Py_None ? ((EffectSlot *)slot)->alo : AL_EFFECTSLOT_NULL;
+    int filter_alo = filter != Py_None ? ((Filter *)filter)->alo : AL_FILTER_NULL;
+    if (!al_call(self->ctx, Source3i, self->alo, AL_AUXILIARY_SEND_FILTER, slot_alo, send, filter_alo)) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject * Source_meth_filter(Source * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"filter", NULL};
+
+    PyObject * filter = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O", keywords, &filter)) {
+        return NULL;
+    }
+
+    if (filter != Py_None && Py_TYPE(filter) != Filter_type) {
+        PyErr_Format(PyExc_ValueError, "filter must be a Filter or None");
+        return NULL;
+    }
+
+    int filter_alo = filter != Py_None ? ((Filter *)filter)->alo : AL_FILTER_NULL;
+    if (!al_call(self->ctx, Sourcei, self->alo, AL_DIRECT_FILTER, filter_alo)) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+// Occlusion for many sources at once through a shared lowpass filter
+// that is reconfigured and copied into each source in turn.
+
+PyObject * Context_meth_filter_gains(Context * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"sources", "gains", "gains_hf", NULL};
+
+    PyObject * sources;
+    PyObject * gains;
+    PyObject * gains_hf = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|O", keywords, &sources, &gains, &gains_hf)) {
+        return NULL;
+    }
+
+    if (!efx_check(self)) {
+        return NULL;
+    }
+
+    PyObject * source_seq = PySequence_Fast(sources, "sources must be a sequence");
+    PyObject * gain_seq = source_seq ? PySequence_Fast(gains, "gains must be a sequence") : NULL;
+    PyObject * gain_hf_seq = gain_seq && gains_hf != Py_None ? PySequence_Fast(gains_hf, "gains_hf must be a sequence") : NULL;
+    if (!gain_seq || (gains_hf != Py_None && !gain_hf_seq)) {
+        Py_XDECREF(source_seq);
+        Py_XDECREF(gain_seq);
+        return NULL;
+    }
+
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(source_seq);
+    bool ok = PySequence_Fast_GET_SIZE(gain_seq) == count && (!gain_hf_seq || PySequence_Fast_GET_SIZE(gain_hf_seq) == count);
+    if (!ok) {
+        PyErr_Format(PyExc_ValueError, "sources and gains must have the same length");
+    }
+
+    if (ok && !self->occlusion_filter) {
+        ok = al_call(self, GenFilters, 1, (ALuint *)&self->occlusion_filter) &&
+            al_call(self, Filteri, self->occlusion_filter, AL_FILTER_TYPE, AL_FILTER_LOWPASS);
+    }
+
+    for (Py_ssize_t i = 0; ok && i < count; ++i) {
+        PyObject * source = PySequence_Fast_GET_ITEM(source_seq, i);
+        if (Py_TYPE(source) != Source_type || ((Source *)source)->ctx != self) {
+            PyErr_Format(PyExc_ValueError, "invalid source at index %zd", i);
+            ok = false;
+            break;
+        }
+        float gain = (float)PyFloat_AsDouble(PySequence_Fast_GET_ITEM(gain_seq, i));
+        float gain_hf = gain_hf_seq ? (float)PyFloat_AsDouble(PySequence_Fast_GET_ITEM(gain_hf_seq, i)) : gain;
+        if (PyErr_Occurred()) {
+            ok = false;
+            break;
+        }
+        ok = filter_apply(self, self->occlusion_filter, AL_FILTER_LOWPASS, gain, gain_hf, 1.0f) &&
+            al_call(self, Sourcei, ((Source *)source)->alo, AL_DIRECT_FILTER, self->occlusion_filter);
+    }
+
+    Py_DECREF(source_seq);
+    Py_DECREF(gain_seq);
+    Py_XDECREF(gain_hf_seq);
+    if (!ok) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+PyMethodDef EffectSlot_methods[] = {
+    {"change", (PyCFunction)EffectSlot_meth_change, METH_VARARGS | METH_KEYWORDS, NULL},
+    {},
+};
+
+PyMemberDef EffectSlot_members[] = {
+    {"alo", T_INT, offsetof(EffectSlot, alo), READONLY, NULL},
+    {"effect", T_INT, offsetof(EffectSlot, effect), READONLY, NULL},
+    {"gain", T_FLOAT, offsetof(EffectSlot, gain), READONLY, NULL},
+    {},
+};
+
+PyType_Slot EffectSlot_slots[] = {
+    {Py_tp_methods, EffectSlot_methods},
+    {Py_tp_members, EffectSlot_members},
+    {Py_tp_dealloc, (void *)BaseObject_dealloc},
+    {},
+};
+
+PyType_Spec EffectSlot_spec = {"modernal.EffectSlot", sizeof(EffectSlot), 0, Py_TPFLAGS_DEFAULT, EffectSlot_slots};
+
+PyMethodDef Filter_methods[] = {
+    {"change", (PyCFunction)Filter_meth_change, METH_VARARGS | METH_KEYWORDS, NULL},
+    {},
+};
+
+PyMemberDef Filter_members[] = {
+    {"alo", T_INT, offsetof(Filter, alo), READONLY, NULL},
+    {"gain", T_FLOAT, offsetof(Filter, gain), READONLY, NULL},
+    {"gain_hf", T_FLOAT, offsetof(Filter, gain_hf), READONLY, NULL},
+    {"gain_lf", T_FLOAT, offsetof(Filter, gain_lf), READONLY, NULL},
+    {},
+};
+
+PyType_Slot Filter_slots[] = {
+    {Py_tp_methods, Filter_methods},
+    {Py_tp_members, Filter_members},
+    {Py_tp_dealloc, (void *)BaseObject_dealloc},
+    {},
+};
+
+PyType_Spec Filter_spec = {"modernal.Filter", sizeof(Filter), 0, Py_TPFLAGS_DEFAULT, Filter_slots};
+
+PyMethodDef Source_methods[] = {
+    {"change", (PyCFunction)Source_meth_change, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"play", (PyCFunction)Source_meth_play, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"stop", (PyCFunction)Source_meth_stop, METH_NOARGS, NULL},
+    {"play_at", (PyCFunction)Source_meth_play_at, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"stop_at", (PyCFunction)Source_meth_stop_at, METH_VARARGS, NULL},
+    {"time", (PyCFunction)Source_meth_time, METH_NOARGS, NULL},
+    {"offset", (PyCFunction)Source_meth_offset, METH_NOARGS, NULL},
+    {"send", (PyCFunction)Source_meth_send, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"filter", (PyCFunction)Source_meth_filter, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"ramp", (PyCFunction)Source_meth_ramp, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"path", (PyCFunction)Source_meth_path, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"cancel", (PyCFunction)Source_meth_cancel, METH_VARARGS | METH_KEYWORDS, NULL},
+    {},
+};
+
+PyGetSetDef Source_getset[] = {
+    {"buffer", (getter)Source_get_buffer, (setter)Source_set_buffer, NULL, NULL},
+    {},
+};
+
+PyMemberDef Source_members[] = {
+    {"alo", T_INT, offsetof(Source, alo), READONLY, NULL},
+    {},
+};
+
+PyType_Slot Source_slots[] = {
+    {Py_tp_methods, Source_methods},
+    {Py_tp_getset, Source_getset},
+    {Py_tp_members, Source_members},
+    {Py_tp_dealloc, (void *)BaseObject_dealloc},
+    {},
+};
+
+PyType_Spec Source_spec = {"modernal.Source", sizeof(Source), 0, Py_TPFLAGS_DEFAULT, Source_slots};
+
+long long grid_cell(EmitterGrid * grid, int x, int y, int z) {
+    return ((long long)(x & 0x1fffff) << 42) | ((long long)(y & 0x1fffff) << 21) | (long long)(z & 0x1fffff);
+}
+
+int grid_coord(EmitterGrid * grid, float value) {
+    return (int)floorf(value / grid->cell_size);
+}
+
+long long grid_key(EmitterGrid * grid, const float * position) {
+    int x = grid_coord(grid, position[0]);
+    int y = grid_coord(grid, position[1]);
+    int z = grid_coord(grid, position[2]);
+    return grid_cell(grid, x, y, z);
+}
+
+void grid_insert(EmitterGrid * grid, Emitter * emitter) {
+    std::vector<Emitter *> & cell = grid->cells[emitter->cell];
+    emitter->cell_index = (int)cell.size();
+    cell.push_back(emitter);
+}
+
+void grid_remove(EmitterGrid * grid, Emitter * emitter) {
+    std::vector<Emitter *> & cell = grid->cells[emitter->cell];
+    Emitter * last = cell.back();
+    cell[emitter->cell_index] = last;
+    last->cell_index = emitter->cell_index;
+    cell.pop_back();
+    if (cell.empty()) {
+        grid->cells.erase(emitter->cell);
+    }
+}
+
+bool emitter_in_range(EmitterGrid * grid, Emitter * emitter) {
+    float dx = emitter->position[0] - grid->listener[0];
+    float dy = emitter->position[1] - grid->listener[1];
+    float dz = emitter->position[2] - grid->listener[2];
+    return dx * dx + dy * dy + dz * dz <= emitter->max_distance * emitter->max_distance;
+}
+
+bool emitter_attach_voice(Context * ctx, Emitter * emitter) {
+    EmitterGrid * grid = ctx->grid;
+    if (grid->free_voices.empty()) {
+        if (grid->max_voices && grid->voices >= grid->max_voices) {
+            if (!emitter->waiting) {
+                emitter->waiting = true;
+                grid->waiting.push_back(emitter);
+            }
+            return true;
+        }
+        ALuint voice = 0;
+        if (!al_call(ctx, GenSources, 1, &voice)) {
+            return false;
+        }
+        grid->voices += 1;
+        grid->free_voices.push_back((int)voice);
+    }
+
+    int voice = grid->free_voices.back();
+    grid->free_voices.pop_back();
+
+    if (!buffer_reset_loop(emitter->buffer) || !buffer_make_resident(emitter->buffer)) {
+        grid->free_voices.push_back(voice);
+        return false;
+    }
+
+    bool ok = al_call(ctx, Sourcei, voice, AL_BUFFER, emitter->buffer->alo);
+    ok = ok && al_call(ctx, Sourcei, voice, AL_LOOPING, emitter->loop);
+    ok = ok && al_call(ctx, Sourcef, voice, AL_GAIN, emitter->gain);
+    ok = ok && al_call(ctx, Sourcef, voice, AL_MAX_DISTANCE, emitter->max_distance);
+    ok = ok && al_call(ctx, Source3f, voice, AL_POSITION, emitter->position[0], emitter->position[1], emitter->position[2]);
+    ok = ok && al_call(ctx, SourcePlay, voice);
+    if (!ok) {
+        grid->free_voices.push_back(voice);
+        return false;
+    }
+
+    emitter->buffer->bound += 1;
+    emitter->voice = voice;
+    return true;
+}
+
+// A freed voice goes to the longest waiting emitter that is still audible.
+// Entries that became inaudible or got a voice meanwhile are dropped here.
+
+bool emitter_assign_waiting(Context * ctx) {
+    EmitterGrid * grid = ctx->grid;
+    while (!grid->waiting.empty()) {
+        Emitter * emitter = grid->waiting.front();
+        grid->waiting.pop_front();
+        emitter->waiting = false;
+        if (emitter->audible_index >= 0 && !emitter->voice) {
+            return emitter_attach_voice(ctx, emitter);
+        }
+    }
+    return true;
+}
+
+void emitter_unwait(EmitterGrid * grid, Emitter * emitter) {
+    if (emitter->waiting) {
+        grid->waiting.erase(std::find(grid->waiting.begin(), grid->waiting.end(), emitter));
+        emitter->waiting = false;
+    }
+}
+
+bool emitter_detach_voice(Context * ctx, Emitter * emitter) {
+    if (!emitter->voice) {
+        return true;
+    }
+    int voice = emitter->voice;
+    emitter->voice = 0;
+    emitter->buffer->bound -= 1;
+    ctx->grid->free_voices.push_back(voice);
+    if (!al_call(ctx, SourceStop, voice) || !al_call(ctx, Sourcei, voice, AL_BUFFER, 0)) {
+        return false;
+    }
+    return emitter_assign_waiting(ctx);
+}
+
+bool emitter_set_audible(Context * ctx, Emitter * emitter, bool audible) {
+    EmitterGrid * grid = ctx->grid;
+    if (audible == (emitter->audible_index >= 0)) {
+        return true;
+    }
+    if (audible) {
+        emitter->audible_index = (int)grid->audible.size();
+        grid->audible.push_back(emitter);
+        return emitter_attach_voice(ctx, emitter);
+    }
+    Emitter * last = grid->audible.back();
+    grid->audible[emitter->audible_index] = last;
+    last->audible_index = emitter->audible_index;
+    grid->audible.pop_back();
+    emitter->audible_index = -1;
+    return emitter_detach_voice(ctx, emitter);
+}
+
+// Called when the listener moves. Only the audible set and the cells within
+// the largest max_distance of the listener are visited.
+
+bool emitters_refresh(Context * ctx) {
+    EmitterGrid * grid = ctx->grid;
+
+    for (int i = (int)grid->audible.size() - 1; i >= 0; --i) {
+        if (i < (int)grid->audible.size() && !emitter_in_range(grid, grid->audible[i])) {
+            if (!emitter_set_audible(ctx, grid->audible[i], false)) {
+                return false;
+            }
+        }
+    }
+
+    int lo[3];
+    int hi[3];
+    long long span = 1;
+    for (int i = 0; i < 3; ++i) {
+        lo[i] = grid_coord(grid, grid->listener[i] - grid->reach);
+        hi[i] = grid_coord(grid, grid->listener[i] + grid->reach);
+        span *= (long long)hi[i] - lo[i] + 1;
+    }
+
+    std::vector<Emitter *> entering;
+    if (span > (long long)grid->cells.size()) {
+        std::unordered_map<long long, std::vector<Emitter *> >::iterator it;
+        for (it = grid->cells.begin(); it != grid->cells.end(); ++it) {
+            for (size_t k = 0; k < it->second.size(); ++k) {
+                Emitter * emitter = it->second[k];
+                if (emitter->audible_index < 0 && emitter_in_range(grid, emitter)) {
+                    entering.push_back(emitter);
+                }
+            }
+        }
+    } else {
+        for (int x = lo[0]; x <= hi[0]; ++x) {
+            for (int y = lo[1]; y <= hi[1]; ++y) {
+                for (int z = lo[2]; z <= hi[2]; ++z) {
+                    std::unordered_map<long long, std::vector<Emitter *> >::iterator it = grid->cells.find(grid_cell(grid, x, y, z));
+                    if (it == grid->cells.end()) {
+                        continue;
+                    }
+                    for (size_t k = 0; k < it->second.size(); ++k) {
+                        Emitter * emitter = it->second[k];
+                        if (emitter->audible_index < 0 && emitter_in_range(grid, emitter)) {
+                            entering.push_back(emitter);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < entering.size(); ++i) {
+        if (!emitter_set_audible(ctx, entering[i], true)) {
+            return false;
+        }
+    }
+
+    return residency_enforce(ctx);
+}
+
+Emitter * Context_meth_emitter(Context * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"buffer", "position", "max_distance", "gain", "loop", NULL};
+
+    Buffer * buffer = NULL;
+    PyObject * position = Py_None;
+    float max_distance = 1.0f;
+    float gain = 1.0f;
+    int loop = true;
 
     int args_ok = PyArg_ParseTupleAndKeywords(
         args,
         kwargs,
-        "|OOOOOOOOOOOOOOO",
+        "O!|Offp",
         keywords,
-        &loop,
-        &gain,
-        &pitch,
-        &time,
-        &min_gain,
-        &max_gain,
-        &max_distance,
-        &rolloff_factor,
-        &cone_outer_gain,
-        &cone_inner_angle,
-        &cone_outer_angle,
-        &reference_dinstance,
+        Buffer_type,
+        &buffer,
         &position,
-        &velocity,
-        &direction
+        &max_distance,
+        &gain,
+        &loop
     );
 
     if (!args_ok) {
         return NULL;
     }
 
-    if (loop != Py_None) {
-        self->ctx->al.Sourcei(self->alo, AL_LOOPING, PyObject_IsTrue(loop));
-    }
-    if (gain != Py_None) {
-        self->ctx->al.Sourcef(self->alo, AL_GAIN, (float)PyFloat_AsDouble(gain));
+    float value[3] = {};
+    if (position != Py_None && py_floats(value, 3, 3, position) < 0) {
+        return NULL;
     }
-    if (pitch != Py_None) {
-        self->ctx->al.Sourcef(self->alo, AL_PITCH, (float)PyFloat_AsDouble(pitch));
+
+    Emitter * res = PyObject_New(Emitter, Emitter_type);
+    res->prev = self;
+    res->next = self->next;
+    self->next->prev = res;
+    self->next = res;
+    res->ctx = self;
+
+    res->buffer = new_ref(buffer);
+    memcpy(res->position, value, sizeof(value));
+    res->max_distance = max_distance;
+    res->gain = gain;
+    res->loop = loop;
+    res->audible_index = -1;
+    res->voice = 0;
+    res->waiting = false;
+
+    EmitterGrid * grid = self->grid;
+    if (max_distance > grid->reach) {
+        grid->reach = max_distance;
     }
-    if (time != Py_None) {
-        self->ctx->al.Sourcef(self->alo, AL_SEC_OFFSET, (float)PyFloat_AsDouble(time));
+
+    res->cell = grid_key(grid, res->position);
+    grid_insert(grid, new_ref(res));
+
+    if (!emitter_set_audible(self, res, emitter_in_range(grid, res)) || !residency_enforce(self)) {
+        return NULL;
     }
-    if (min_gain != Py_None) {
-        self->ctx->al.Sourcef(self->alo, AL_MIN_GAIN, (float)PyFloat_AsDouble(min_gain));
+    return res;
+}
+
+PyObject * Emitter_meth_change(Emitter * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"position", "max_distance", "gain", NULL};
+
+    PyObject * position = Py_None;
+    PyObject * max_distance = Py_None;
+    PyObject * gain = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|OOO", keywords, &position, &max_distance, &gain)) {
+        return NULL;
     }
-    if (max_gain != Py_None) {
-        self->ctx->al.Sourcef(self->alo, AL_MAX_GAIN, (float)PyFloat_AsDouble(max_gain));
+
+    Context * ctx = self->ctx;
+    EmitterGrid * grid = ctx->grid;
+
+    if (position != Py_None) {
+        if (py_floats(self->position, 3, 3, position) < 0) {
+            return NULL;
+        }
+        long long cell = grid_key(grid, self->position);
+        if (cell != self->cell) {
+            grid_remove(grid, self);
+            self->cell = cell;
+            grid_insert(grid, self);
+        }
+        if (self->voice && !al_call(ctx, Source3f, self->voice, AL_POSITION, self->position[0], self->position[1], self->position[2])) {
+            return NULL;
+        }
     }
     if (max_distance != Py_None) {
-        self->ctx->al.Sourcef(self->alo, AL_MAX_DISTANCE, (float)PyFloat_AsDouble(max_distance));
+        self->max_distance = (float)PyFloat_AsDouble(max_distance);
+        if (self->max_distance > grid->reach) {
+            grid->reach = self->max_distance;
+        }
+        if (self->voice && !al_call(ctx, Sourcef, self->voice, AL_MAX_DISTANCE, self->max_distance)) {
+            return NULL;
+        }
     }
-    if (rolloff_factor != Py_None) {
-        self->ctx->al.Sourcef(self->alo, AL_ROLLOFF_FACTOR, (float)PyFloat_AsDouble(rolloff_factor));
+    if (gain != Py_None) {
+        self->gain = (float)PyFloat_AsDouble(gain);
+        if (self->voice && !al_call(ctx, Sourcef, self->voice, AL_GAIN, self->gain)) {
+            return NULL;
+        }
     }
-    if (cone_outer_gain != Py_None) {
-        self->ctx->al.Sourcef(self->alo, AL_CONE_OUTER_GAIN, (float)PyFloat_AsDouble(cone_outer_gain));
+
+    if (PyErr_Occurred()) {
+        return NULL;
     }
-    if (cone_inner_angle != Py_None) {
-        self->ctx->al.Sourcef(self->alo, AL_CONE_INNER_ANGLE, (float)PyFloat_AsDouble(cone_inner_angle));
+
+    if (!emitter_set_audible(ctx, self, emitter_in_range(grid, self)) || !residency_enforce(ctx)) {
+        return NULL;
     }
-    if (cone_outer_angle != Py_None) {
-        self->ctx->al.Sourcef(self->alo, AL_CONE_OUTER_ANGLE, (float)PyFloat_AsDouble(cone_outer_angle));
+    Py_RETURN_NONE;
+}
+
+PyObject * Emitter_get_audible(Emitter * self) {
+    return PyBool_FromLong(self->audible_index >= 0);
+}
+
+PyObject * Emitter_get_position(Emitter * self) {
+    return Py_BuildValue("(fff)", self->position[0], self->position[1], self->position[2]);
+}
+
+PyObject * Context_meth_offsets(Context * self, PyObject * args) {
+    PyObject * sources;
+
+    if (!PyArg_ParseTuple(args, "O", &sources)) {
+        return NULL;
     }
-    if (reference_dinstance != Py_None) {
-        self->ctx->al.Sourcef(self->alo, AL_REFERENCE_DISTANCE, (float)PyFloat_AsDouble(reference_dinstance));
+
+    PyObject * seq = PySequence_Fast(sources, "sources must be a sequence");
+    if (!seq) {
+        return NULL;
     }
-    if (position != Py_None) {
-        float value[3] = {};
-        py_floats(value, 3, 3, position);
-        self->ctx->al.Sourcefv(self->alo, AL_POSITION, value);
+
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(seq);
+    PyObject * res = PyList_New(count);
+    for (Py_ssize_t i = 0; i < count; ++i) {
+        PyObject * source = PySequence_Fast_GET_ITEM(seq, i);
+        if (Py_TYPE(source) != Source_type || ((Source *)source)->ctx != self) {
+            PyErr_Format(PyExc_ValueError, "invalid source at index %zd", i);
+            Py_DECREF(res);
+            Py_DECREF(seq);
+            return NULL;
+        }
+        PyObject * offset = source_offset((Source *)source);
+        if (!offset) {
+            Py_DECREF(res);
+            Py_DECREF(seq);
+            return NULL;
+        }
+        PyList_SET_ITEM(res, i, offset);
     }
-    if (velocity != Py_None) {
-        float value[3] = {};
-        py_floats(value, 3, 3, velocity);
-        self->ctx->al.Sourcefv(self->alo, AL_VELOCITY, value);
+    Py_DECREF(seq);
+    return res;
+}
+
+// Scene snapshot: SnapshotHeader, the listener and count SnapshotSource records.
+// Buffers and sources are referenced by their AL names, so a snapshot can only
+// be restored into the context that took it. Emitter voices are not included.
+// AL names are reused after a release, so records match live objects by their
+// per-context serial and the header carries the id of the context.
+// Restoring cancels automation on the restored sources and, unless
+// stop_unlisted=False, stops any playing source that the snapshot does not list.
+
+const char snapshot_magic[8] = {'M', 'A', 'L', 'S', 'N', 'A', 'P', 0};
+const unsigned snapshot_version = 2;
+
+const int snapshot_source_floats[] = {
+    AL_GAIN,
+    AL_PITCH,
+    AL_MIN_GAIN,
+    AL_MAX_GAIN,
+    AL_MAX_DISTANCE,
+    AL_ROLLOFF_FACTOR,
+    AL_CONE_OUTER_GAIN,
+    AL_CONE_INNER_ANGLE,
+    AL_CONE_OUTER_ANGLE,
+    AL_REFERENCE_DISTANCE,
+};
+
+const int snapshot_source_vectors[] = {AL_POSITION, AL_VELOCITY, AL_DIRECTION};
+
+struct SnapshotHeader {
+    char magic[8];
+    unsigned version;
+    unsigned count;
+    unsigned long long context;
+};
+
+struct SnapshotListener {
+    float gain;
+    float position[3];
+    float velocity[3];
+    float orientation[6];
+};
+
+struct SnapshotSource {
+    unsigned long long source;
+    unsigned long long buffer;
+    int state;
+    int looping;
+    int relative;
+    int offset;
+    float floats[10];
+    float vectors[3][3];
+};
+
+PyObject * Context_meth_snapshot(Context * self) {
+    if (!scheduler_reap(self)) {
+        return NULL;
     }
-    if (direction != Py_None) {
-        float value[3] = {};
-        py_floats(value, 3, 3, direction);
-        self->ctx->al.Sourcefv(self->alo, AL_DIRECTION, value);
+
+    std::vector<Source *> sources;
+    for (BaseObject * obj = self->next; obj != self; obj = obj->next) {
+        if (Py_TYPE(obj) == Source_type) {
+            sources.push_back((Source *)obj);
+        }
     }
 
-    Py_RETURN_NONE;
+    size_t size = sizeof(SnapshotHeader) + sizeof(SnapshotListener) + sources.size() * sizeof(SnapshotSource);
+    PyObject * res = PyBytes_FromStringAndSize(NULL, size);
+    if (!res) {
+        return NULL;
+    }
+
+    char * ptr = PyBytes_AS_STRING(res);
+    memset(ptr, 0, size);
+
+    SnapshotHeader * header = (SnapshotHeader *)ptr;
+    memcpy(header->magic, snapshot_magic, sizeof(snapshot_magic));
+    header->version = snapshot_version;
+    header->count = (unsigned)sources.size();
+    header->context = self->uid;
+
+    SnapshotListener * listener = (SnapshotListener *)(header + 1);
+    bool ok = al_call(self, GetListenerf, AL_GAIN, &listener->gain);
+    ok = ok && al_call(self, GetListenerfv, AL_POSITION, listener->position);
+    ok = ok && al_call(self, GetListenerfv, AL_VELOCITY, listener->velocity);
+    ok = ok && al_call(self, GetListenerfv, AL_ORIENTATION, listener->orientation);
+
+    SnapshotSource * records = (SnapshotSource *)(listener + 1);
+    for (size_t i = 0; ok && i < sources.size(); ++i) {
+        Source * source = sources[i];
+        SnapshotSource & record = records[i];
+        record.source = source->serial;
+        record.buffer = source->buffer ? source->buffer->serial : 0;
+        record.state = AL_STOPPED;
+        for (int j = 0; ok && j < 10; ++j) {
+            ok = al_call(self, GetSourcef, source->alo, snapshot_source_floats[j], &record.floats[j]);
+        }
+        for (int j = 0; ok && j < 3; ++j) {
+            ok = al_call(self, GetSourcefv, source->alo, snapshot_source_vectors[j], record.vectors[j]);
+        }
+        ok = ok && al_call(self, GetSourcei, source->alo, AL_LOOPING, &record.looping);
+        ok = ok && al_call(self, GetSourcei, source->alo, AL_SOURCE_RELATIVE, &record.relative);
+        if (ok && source->playing) {
+            ok = al_call(self, GetSourcei, source->alo, AL_SOURCE_STATE, &record.state);
+            ok = ok && al_call(self, GetSourcei, source->alo, AL_SAMPLE_OFFSET, &record.offset);
+        }
+    }
+
+    if (!ok) {
+        Py_DECREF(res);
+        return NULL;
+    }
+    return res;
 }
 
-PyObject * Source_meth_play(Source * self, PyObject * args, PyObject * kwargs) {
-    Buffer * buffer = NULL;
+// Restore reuses live sources by AL name and creates the missing ones with a
+// single alGenSources. Parameters are written between alDeferUpdatesSOFT and
+// alProcessUpdatesSOFT, then the playing sources start with one alSourcePlayv.
 
-    if (!PyArg_ParseTuple(args, "|O!", Buffer_type, &buffer)) {
+PyObject * Context_meth_restore(Context * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"snapshot", "stop_unlisted", NULL};
+
+    Py_buffer view = {};
+    int stop_unlisted = true;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "y*|p", keywords, &view, &stop_unlisted)) {
         return NULL;
     }
 
-    if (self->playing) {
-        PyObject * call = PyObject_CallMethod((PyObject *)self, "stop", NULL);
-        Py_XDECREF(call);
-        if (!call) {
-            return NULL;
+    const SnapshotHeader * header = (const SnapshotHeader *)view.buf;
+    size_t fixed = sizeof(SnapshotHeader) + sizeof(SnapshotListener);
+    bool valid = (size_t)view.len >= fixed && !memcmp(header->magic, snapshot_magic, sizeof(snapshot_magic));
+    valid = valid && header->version == snapshot_version;
+    valid = valid && (size_t)view.len == fixed + (size_t)header->count * sizeof(SnapshotSource);
+    if (!valid) {
+        PyBuffer_Release(&view);
+        PyErr_Format(PyExc_ValueError, "invalid snapshot");
+        return NULL;
+    }
+    if (header->context != self->uid) {
+        PyBuffer_Release(&view);
+        PyErr_Format(PyExc_ValueError, "snapshot was taken from another context");
+        return NULL;
+    }
+
+    int count = (int)header->count;
+    SnapshotListener listener = *(const SnapshotListener *)(header + 1);
+    std::vector<SnapshotSource> records(count);
+    memcpy(records.data(), (const char *)view.buf + fixed, count * sizeof(SnapshotSource));
+    PyBuffer_Release(&view);
+
+    if (!scheduler_reap(self)) {
+        return NULL;
+    }
+
+    std::unordered_map<unsigned long long, Source *> live_sources;
+    std::unordered_map<unsigned long long, Buffer *> live_buffers;
+    for (BaseObject * obj = self->next; obj != self; obj = obj->next) {
+        if (Py_TYPE(obj) == Source_type) {
+            live_sources[((Source *)obj)->serial] = (Source *)obj;
+        } else if (PyObject_TypeCheck(obj, Buffer_type)) {
+            live_buffers[((Buffer *)obj)->serial] = (Buffer *)obj;
         }
     }
-    PyObject * call = Source_meth_change(self, empty_tuple, kwargs);
-    Py_XDECREF(call);
-    if (!call) {
+
+    std::vector<Buffer *> buffers(count);
+    int missing = 0;
+    for (int i = 0; i < count; ++i) {
+        buffers[i] = NULL;
+        if (records[i].buffer) {
+            std::unordered_map<unsigned long long, Buffer *>::iterator it = live_buffers.find(records[i].buffer);
+            if (it == live_buffers.end()) {
+                PyErr_Format(PyExc_ValueError, "snapshot references a released buffer");
+                return NULL;
+            }
+            buffers[i] = it->second;
+        }
+        if (live_sources.find(records[i].source) == live_sources.end()) {
+            missing += 1;
+        }
+    }
+
+    std::vector<int> names(missing);
+    if (missing && !al_call(self, GenSources, missing, (ALuint *)names.data())) {
         return NULL;
     }
-    if (buffer) {
-        if (PyObject_SetAttrString((PyObject *)self, "buffer", (PyObject *)buffer) < 0) {
-            return NULL;
+
+    std::vector<Source *> sources(count);
+    std::vector<bool> created_sources(count);
+    for (int i = 0, created = 0; i < count; ++i) {
+        std::unordered_map<unsigned long long, Source *>::iterator it = live_sources.find(records[i].source);
+        created_sources[i] = it == live_sources.end();
+        if (it != live_sources.end()) {
+            sources[i] = new_ref(it->second);
+            live_sources.erase(it);
+            continue;
+        }
+        Source * source = PyObject_New(Source, Source_type);
+        source->prev = self;
+        source->next = self->next;
+        self->next->prev = source;
+        self->next = source;
+        source->ctx = self;
+        source->serial = ++self->object_serial;
+        source->buffer = NULL;
+        source->playing = false;
+        source->alo = names[created++];
+        sources[i] = source;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    {
+        std::lock_guard<std::mutex> guard(self->automation->lock);
+        for (int i = 0; i < count; ++i) {
+            automation_cancel(self->automation, sources[i]->alo, 0);
+        }
+    }
+    Py_END_ALLOW_THREADS
+
+    // live_sources now holds only the sources the snapshot does not list
+    std::vector<Source *> unlisted;
+    std::vector<int> stopping;
+    for (int i = 0; i < count; ++i) {
+        if (sources[i]->playing) {
+            scheduler_cancel(self->scheduler, sources[i]->alo);
+            stopping.push_back(sources[i]->alo);
+        }
+    }
+    for (std::unordered_map<unsigned long long, Source *>::iterator it = live_sources.begin(); stop_unlisted && it != live_sources.end(); ++it) {
+        if (it->second->playing) {
+            scheduler_cancel(self->scheduler, it->second->alo);
+            stopping.push_back(it->second->alo);
+            unlisted.push_back(it->second);
+        }
+    }
+    bool deferred = self->al.DeferUpdatesSOFT && self->al.ProcessUpdatesSOFT;
+    bool ok = !stopping.size() || al_call(self, SourceStopv, (int)stopping.size(), (ALuint *)stopping.data());
+    for (size_t i = 0; ok && i < unlisted.size(); ++i) {
+        ok = al_call(self, Sourcei, unlisted[i]->alo, AL_BUFFER, 0);
+        unlisted[i]->buffer->bound -= 1;
+        unlisted[i]->playing = false;
+    }
+    ok = ok && (!deferred || al_call(self, DeferUpdatesSOFT));
+    ok = ok && al_call(self, Listenerf, AL_GAIN, listener.gain);
+    ok = ok && al_call(self, Listenerfv, AL_POSITION, listener.position);
+    ok = ok && al_call(self, Listenerfv, AL_VELOCITY, listener.velocity);
+    ok = ok && al_call(self, Listenerfv, AL_ORIENTATION, listener.orientation);
+    memcpy(self->grid->listener, listener.position, sizeof(listener.position));
+
+    std::vector<int> playing;
+    std::vector<int> paused;
+    for (int i = 0; ok && i < count; ++i) {
+        Source * source = sources[i];
+        SnapshotSource & record = records[i];
+        if (source->playing) {
+            ok = al_call(self, Sourcei, source->alo, AL_BUFFER, 0);
+            source->buffer->bound -= 1;
+            source->playing = false;
+        }
+        for (int j = 0; ok && j < 10; ++j) {
+            ok = al_call(self, Sourcef, source->alo, snapshot_source_floats[j], record.floats[j]);
+        }
+        for (int j = 0; ok && j < 3; ++j) {
+            ok = al_call(self, Sourcefv, source->alo, snapshot_source_vectors[j], record.vectors[j]);
         }
+        ok = ok && al_call(self, Sourcei, source->alo, AL_LOOPING, record.looping);
+        ok = ok && al_call(self, Sourcei, source->alo, AL_SOURCE_RELATIVE, record.relative);
+
+        Buffer * previous = source->buffer;
+        source->buffer = buffers[i] ? new_ref(buffers[i]) : NULL;
+        Py_XDECREF(previous);
+
+        if (ok && source->buffer && (record.state == AL_PLAYING || record.state == AL_PAUSED)) {
+            ok = buffer_make_resident(source->buffer);
+            ok = ok && al_call(self, Sourcei, source->alo, AL_BUFFER, source->buffer->alo);
+            ok = ok && al_call(self, Sourcei, source->alo, AL_SAMPLE_OFFSET, record.offset);
+            if (ok) {
+                source->buffer->bound += 1;
+                source->playing = true;
+                playing.push_back(source->alo);
+                if (record.state == AL_PAUSED) {
+                    paused.push_back(source->alo);
+                }
+            }
+        }
+    }
+
+    if (deferred) {
+        ok = al_call(self, ProcessUpdatesSOFT) && ok;
+    }
+
+    ok = ok && (!playing.size() || al_call(self, SourcePlayv, (int)playing.size(), (ALuint *)playing.data()));
+    ok = ok && (!paused.size() || al_call(self, SourcePausev, (int)paused.size(), (ALuint *)paused.data()));
+    ok = ok && residency_enforce(self) && emitters_refresh(self);
+
+    if (!ok) {
+        // created sources are deleted again; errors from the cleanup are
+        // dropped in favour of the original exception
+        PyObject * type, * value, * traceback;
+        PyErr_Fetch(&type, &value, &traceback);
+        for (int i = 0; i < count; ++i) {
+            Source * source = sources[i];
+            if (created_sources[i]) {
+                if (source->playing) {
+                    al_call(self, SourceStop, source->alo);
+                    source->buffer->bound -= 1;
+                    source->playing = false;
+                }
+                al_call(self, Sourcei, source->alo, AL_BUFFER, 0);
+                al_call(self, DeleteSources, 1, (ALuint *)&source->alo);
+                Py_CLEAR(source->buffer);
+                object_unlink(source);
+            }
+            Py_DECREF(source);
+        }
+        PyErr_Restore(type, value, traceback);
+        return NULL;
+    }
+
+    PyObject * res = PyList_New(count);
+    for (int i = 0; i < count; ++i) {
+        PyList_SET_ITEM(res, i, (PyObject *)sources[i]);
+    }
+    return res;
+}
+
+PyObject * Context_meth_audible(Context * self) {
+    EmitterGrid * grid = self->grid;
+    PyObject * res = PyList_New(grid->audible.size());
+    for (size_t i = 0; i < grid->audible.size(); ++i) {
+        PyList_SET_ITEM(res, i, (PyObject *)new_ref(grid->audible[i]));
+    }
+    return res;
+}
+
+PyMethodDef Emitter_methods[] = {
+    {"change", (PyCFunction)Emitter_meth_change, METH_VARARGS | METH_KEYWORDS, NULL},
+    {},
+};
+
+PyGetSetDef Emitter_getset[] = {
+    {"audible", (getter)Emitter_get_audible, NULL, NULL, NULL},
+    {"position", (getter)Emitter_get_position, NULL, NULL, NULL},
+    {},
+};
+
+PyMemberDef Emitter_members[] = {
+    {"buffer", T_OBJECT, offsetof(Emitter, buffer), READONLY, NULL},
+    {"max_distance", T_FLOAT, offsetof(Emitter, max_distance), READONLY, NULL},
+    {"gain", T_FLOAT, offsetof(Emitter, gain), READONLY, NULL},
+    {"voice", T_INT, offsetof(Emitter, voice), READONLY, NULL},
+    {},
+};
+
+PyType_Slot Emitter_slots[] = {
+    {Py_tp_methods, Emitter_methods},
+    {Py_tp_getset, Emitter_getset},
+    {Py_tp_members, Emitter_members},
+    {Py_tp_dealloc, (void *)BaseObject_dealloc},
+    {},
+};
+
+PyType_Spec Emitter_spec = {"modernal.Emitter", sizeof(Emitter), 0, Py_TPFLAGS_DEFAULT, Emitter_slots};
+
+int bank_compare(const Bank * self, const BankEntry * entry, const char * name, size_t length) {
+    size_t common = length < entry->name_length ? length : entry->name_length;
+    int res = memcmp(name, self->names + entry->name_offset, common);
+    if (res) {
+        return res;
+    }
+    return length < entry->name_length ? -1 : length > entry->name_length ? 1 : 0;
+}
+
+Bank * Context_meth_open_bank(Context * self, PyObject * args) {
+    const char * path = NULL;
+
+    if (!PyArg_ParseTuple(args, "s", &path)) {
+        return NULL;
+    }
+
+    size_t size = 0;
+    char * ptr = map_file(path, &size);
+    if (!ptr) {
+        PyErr_Format(PyExc_OSError, "cannot map %s", path);
+        return NULL;
+    }
+
+    const BankHeader * header = (const BankHeader *)ptr;
+    bool valid = size >= sizeof(BankHeader) && !memcmp(header->magic, bank_magic, 8) && header->version == bank_version;
+    valid = valid && sizeof(BankHeader) + (unsigned long long)header->count * sizeof(BankEntry) <= size;
+    valid = valid && header->names_offset <= size && header->names_size <= size - header->names_offset;
+    const BankEntry * entries = (const BankEntry *)(ptr + sizeof(BankHeader));
+    for (unsigned i = 0; valid && i < header->count; ++i) {
+        valid = entries[i].offset <= size && entries[i].size <= size - entries[i].offset;
+        valid = valid && (unsigned long long)entries[i].name_offset + entries[i].name_length <= header->names_size;
+    }
+    if (!valid) {
+        unmap_file(ptr, size);
+        PyErr_Format(PyExc_ValueError, "%s is not a sound bank", path);
+        return NULL;
+    }
+
+    Bank * res = PyObject_New(Bank, Bank_type);
+    res->prev = self;
+    res->next = self->next;
+    self->next->prev = res;
+    self->next = res;
+    res->ctx = self;
+
+    res->ptr = ptr;
+    res->size = size;
+    res->count = (int)header->count;
+    res->entries = entries;
+    res->names = ptr + header->names_offset;
+    res->buffers = (Buffer **)calloc(res->count + 1, sizeof(Buffer *));
+    return res;
+}
+
+PyObject * Bank_subscript(Bank * self, PyObject * key) {
+    Py_ssize_t length = 0;
+    const char * name = PyUnicode_AsUTF8AndSize(key, &length);
+    if (!name) {
+        return NULL;
+    }
+
+    int lo = 0;
+    int hi = self->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        int cmp = bank_compare(self, self->entries + mid, name, length);
+        if (cmp == 0) {
+            lo = mid;
+            break;
+        }
+        if (cmp < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+
+    if (lo >= self->count || bank_compare(self, self->entries + lo, name, length)) {
+        PyErr_SetObject(PyExc_KeyError, key);
+        return NULL;
     }
-    self->buffer->bound += 1;
-    self->ctx->al.Sourcei(self->alo, AL_BUFFER, self->buffer->alo);
-    self->ctx->al.SourcePlay(self->alo);
-    self->playing = true;
-    Py_RETURN_NONE;
-}
 
-PyObject * Source_meth_stop(Source * self) {
-    if (self->playing) {
-        self->ctx->al.SourceStop(self->alo);
-        self->ctx->al.Sourcei(self->alo, AL_BUFFER, 0);
-        self->buffer->bound -= 1;
+    if (self->buffers[lo]) {
+        return (PyObject *)new_ref(self->buffers[lo]);
     }
-    Py_RETURN_NONE;
+
+    const BankEntry * entry = self->entries + lo;
+    PyObject * buffer_kwargs = Py_BuildValue("{sisi}", "format", entry->format, "frequency", entry->frequency);
+    Buffer * buffer = Context_meth_buffer(self->ctx, empty_tuple, buffer_kwargs);
+    Py_DECREF(buffer_kwargs);
+    if (!buffer) {
+        return NULL;
+    }
+
+    // The clip borrows the mapping without owning the bank, which would be a
+    // reference cycle. Bank_dealloc uploads the clip before unmapping.
+    buffer_set_resident(buffer, false);
+    buffer->size = (int)entry->size;
+    buffer->source_bank = self;
+    buffer->source_data = self->ptr + entry->offset;
+    self->buffers[lo] = buffer;
+    return (PyObject *)new_ref(buffer);
 }
 
-PyObject * Source_meth_time(Source * self) {
-    float time = 0.0f;
-    self->ctx->al.GetSourcefv(self->alo, AL_SEC_OFFSET, &time);
-    return PyFloat_FromDouble(time);
+Py_ssize_t Bank_length(Bank * self) {
+    return self->count;
 }
 
-PyObject * Source_get_buffer(Source * self) {
-    if (self->buffer) {
-        return (PyObject *)new_ref(self->buffer);
+PyObject * Bank_meth_names(Bank * self) {
+    PyObject * res = PyList_New(self->count);
+    for (int i = 0; i < self->count; ++i) {
+        const BankEntry * entry = self->entries + i;
+        PyList_SET_ITEM(res, i, PyUnicode_FromStringAndSize(self->names + entry->name_offset, entry->name_length));
     }
-    Py_RETURN_NONE;
+    return res;
 }
 
-int Source_set_buffer(Source * self, PyObject * value) {
-    if (self->playing) {
-        PyErr_BadInternalCall();
-        return -1;
-    }
-    if (value == Py_None) {
-        self->buffer = NULL;
-        return 0;
-    }
-    if (Py_TYPE(value) != Buffer_type) {
-        PyErr_BadInternalCall();
-        return -1;
+void Bank_dealloc(Bank * self) {
+    for (int i = 0; i < self->count; ++i) {
+        Buffer * buffer = self->buffers[i];
+        if (!buffer) {
+            continue;
+        }
+        // only clips still referenced outside the bank are uploaded before the unmap
+        if (Py_REFCNT(buffer) == 1) {
+            buffer_set_resident(buffer, false);
+            object_unlink(buffer);
+        } else if (buffer->source_data >= self->ptr && buffer->source_data < self->ptr + self->size) {
+            if (!buffer_make_resident(buffer)) {
+                PyErr_WriteUnraisable((PyObject *)buffer);
+            }
+            buffer_detach_source(buffer);
+        }
+        Py_DECREF(buffer);
     }
-    Buffer * buffer = (Buffer *)value;
-    self->buffer = new_ref(buffer);
-    return 0;
+    object_unlink(self);
+    unmap_file(self->ptr, self->size);
+    free(self->buffers);
+    Py_TYPE(self)->tp_free(self);
 }
 
-PyMethodDef Source_methods[] = {
-    {"change", (PyCFunction)Source_meth_change, METH_VARARGS | METH_KEYWORDS, NULL},
-    {"play", (PyCFunction)Source_meth_play, METH_VARARGS | METH_KEYWORDS, NULL},
-    {"stop", (PyCFunction)Source_meth_stop, METH_NOARGS, NULL},
-    {"time", (PyCFunction)Source_meth_time, METH_NOARGS, NULL},
+PyMethodDef Bank_methods[] = {
+    {"names", (PyCFunction)Bank_meth_names, METH_NOARGS, NULL},
     {},
 };
 
-PyGetSetDef Source_getset[] = {
-    {"buffer", (getter)Source_get_buffer, (setter)Source_set_buffer, NULL, NULL},
+PyType_Slot Bank_slots[] = {
+    {Py_tp_methods, Bank_methods},
+    {Py_mp_subscript, (void *)Bank_subscript},
+    {Py_mp_length, (void *)Bank_length},
+    {Py_tp_dealloc, (void *)Bank_dealloc},
     {},
 };
 
-PyMemberDef Source_members[] = {
-    {"alo", T_INT, offsetof(Source, alo), READONLY, NULL},
-    {},
-};
+PyType_Spec Bank_spec = {"modernal.Bank", sizeof(Bank), 0, Py_TPFLAGS_DEFAULT, Bank_slots};
 
-PyType_Slot Source_slots[] = {
-    {Py_tp_methods, Source_methods},
-    {Py_tp_getset, Source_getset},
-    {Py_tp_members, Source_members},
-    {Py_tp_dealloc, (void *)BaseObject_dealloc},
-    {},
+struct BankClip {
+    std::string name;
+    Py_buffer view;
+    int format;
+    int frequency;
 };
 
-PyType_Spec Source_spec = {"modernal.Source", sizeof(Source), 0, Py_TPFLAGS_DEFAULT, Source_slots};
+bool operator < (const BankClip & a, const BankClip & b) {
+    return a.name < b.name;
+}
 
-Context * modernal_meth_create_context(PyObject * self, PyObject * args, PyObject * kwargs) {
-    static char * keywords[] = {"device_name", "libal", NULL};
+PyObject * modernal_meth_pack_bank(PyObject * self, PyObject * args) {
+    const char * path = NULL;
+    PyObject * clips = NULL;
 
-    const char * device_name = NULL;
-    const char * libal = DEFAULT_LIBAL;
+    if (!PyArg_ParseTuple(args, "sO", &path, &clips)) {
+        return NULL;
+    }
+
+    PyObject * seq = PySequence_Fast(clips, "not iterable");
+    if (!seq) {
+        return NULL;
+    }
+
+    int count = (int)PySequence_Fast_GET_SIZE(seq);
+    std::vector<BankClip> items(count);
+    int parsed = 0;
+
+    for (; parsed < count; ++parsed) {
+        BankClip & clip = items[parsed];
+        const char * name = NULL;
+        Py_ssize_t length = 0;
+        PyObject * item = PySequence_Fast_GET_ITEM(seq, parsed);
+        if (!PyArg_ParseTuple(item, "s#y*ii", &name, &length, &clip.view, &clip.format, &clip.frequency)) {
+            break;
+        }
+        clip.name.assign(name, length);
+    }
+
+    Py_DECREF(seq);
+
+    FILE * file = NULL;
+    if (parsed == count) {
+        file = fopen(path, "wb");
+        if (!file) {
+            PyErr_Format(PyExc_OSError, "cannot open %s", path);
+        }
+    }
+
+    if (file) {
+        std::sort(items.begin(), items.end());
+
+        BankHeader header = {};
+        memcpy(header.magic, bank_magic, 8);
+        header.version = bank_version;
+        header.count = count;
+        header.names_offset = sizeof(BankHeader) + (unsigned long long)count * sizeof(BankEntry);
+
+        std::vector<BankEntry> entries(count);
+        std::string names;
+        for (int i = 0; i < count; ++i) {
+            entries[i].name_offset = (unsigned)names.size();
+            entries[i].name_length = (unsigned)items[i].name.size();
+            names += items[i].name;
+        }
+        header.names_size = names.size();
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|ss", keywords, &device_name, &libal)) {
+        unsigned long long offset = (header.names_offset + header.names_size + 15) & ~15ULL;
+        for (int i = 0; i < count; ++i) {
+            entries[i].offset = offset;
+            entries[i].size = (unsigned)items[i].view.len;
+            entries[i].format = items[i].format;
+            entries[i].frequency = items[i].frequency;
+            offset = (offset + items[i].view.len + 15) & ~15ULL;
+        }
+
+        const char padding[16] = {};
+        fwrite(&header, sizeof(header), 1, file);
+        fwrite(entries.data(), sizeof(BankEntry), count, file);
+        fwrite(names.data(), 1, names.size(), file);
+        unsigned long long written = header.names_offset + header.names_size;
+        for (int i = 0; i < count; ++i) {
+            fwrite(padding, 1, (size_t)(entries[i].offset - written), file);
+            fwrite(items[i].view.buf, 1, items[i].view.len, file);
+            written = entries[i].offset + items[i].view.len;
+        }
+
+        if (ferror(file)) {
+            PyErr_Format(PyExc_OSError, "cannot write %s", path);
+        }
+        fclose(file);
+    }
+
+    for (int i = 0; i < parsed; ++i) {
+        PyBuffer_Release(&items[i].view);
+    }
+
+    if (PyErr_Occurred()) {
         return NULL;
     }
+    Py_RETURN_NONE;
+}
 
-    Context * res = PyObject_New(Context, Context_type);
-    res->next = res;
-    res->prev = res;
+// Latency profiles pick the mixer refresh rate, which sets the period size.
+// The period count is left to the driver configuration.
+
+int context_latency_refresh(const char * latency) {
+    if (!latency) {
+        return 0;
+    }
+    if (!strcmp(latency, "low")) {
+        return 200;
+    }
+    if (!strcmp(latency, "balanced")) {
+        return 50;
+    }
+    if (!strcmp(latency, "throughput")) {
+        return 25;
+    }
+    return -1;
+}
+
+PyObject * context_attributes(Context * self) {
+    int size = 0;
+    self->alc.GetIntegerv(self->device, ALC_ATTRIBUTES_SIZE, 1, &size);
+    std::vector<int> attribs(size > 0 ? size : 1);
+    if (size > 0) {
+        self->alc.GetIntegerv(self->device, ALC_ALL_ATTRIBUTES, size, attribs.data());
+    }
 
-    res->libal = load_al_library(libal);
+    PyObject * res = PyDict_New();
+    for (int i = 0; i + 1 < size && attribs[i]; i += 2) {
+        PyObject * key = NULL;
+        switch (attribs[i]) {
+            case ALC_FREQUENCY: key = PyUnicode_FromString("frequency"); break;
+            case ALC_REFRESH: key = PyUnicode_FromString("refresh"); break;
+            case ALC_SYNC: key = PyUnicode_FromString("sync"); break;
+            case ALC_MONO_SOURCES: key = PyUnicode_FromString("mono_sources"); break;
+            case ALC_STEREO_SOURCES: key = PyUnicode_FromString("stereo_sources"); break;
+            default: key = PyLong_FromLong(attribs[i]); break;
+        }
+        PyObject * value = PyLong_FromLong(attribs[i + 1]);
+        PyDict_SetItem(res, key, value);
+        Py_DECREF(key);
+        Py_DECREF(value);
+    }
+    return res;
+}
+
+// Opening the library, the device and the context and resolving symbols does not
+// touch Python state, so with async_open=True it runs on a native thread.
+// Buffers created before the context is ready are uploaded by context_finish.
+
+bool context_open(Context * res, ContextOpen * open) {
+    res->libal = load_al_library(open->libal.c_str());
     if (!res->libal) {
-        PyErr_Format(PyExc_Exception, "%s not loaded", libal);
-        return NULL;
+        open->error_kind = PyExc_Exception;
+        open->error = open->libal + " not loaded";
+        return false;
     }
 
-    #define load(name) *(void **)&res->alc.name = (void *)load_al_method(res->libal, "alc" # name)
+    const char * missing = NULL;
+
+    #define load(name) *(void **)&res->alc.name = (void *)load_al_method(res->libal, "alc" # name, &missing)
     load(OpenDevice);
     load(CreateContext);
     load(MakeContextCurrent);
     load(GetError);
+    load(GetIntegerv);
+    load(IsExtensionPresent);
+    load(GetProcAddress);
     #undef load
 
-    if (PyErr_Occurred()) {
-        return NULL;
+    if (missing) {
+        open->error_kind = PyExc_Exception;
+        open->error = std::string(missing) + " not found";
+        return false;
     }
 
-    res->device = res->alc.OpenDevice(device_name);
+    res->device = res->alc.OpenDevice(open->default_device ? NULL : open->device_name.c_str());
     if (!res->device) {
-        return NULL;
+        open->error_kind = error_type;
+        open->error = "alcOpenDevice failed for " + (open->default_device ? std::string("the default device") : open->device_name);
+        return false;
     }
 
-    int attribs[] = {
-        0, 0,
-    };
-
-    res->ctx = res->alc.CreateContext(res->device, attribs);
+    res->ctx = res->alc.CreateContext(res->device, open->attribs.data());
     if (!res->ctx) {
-        return NULL;
+        open->error_kind = error_type;
+        open->error = std::string("alcCreateContext failed with ") + alc_error_name(res->alc.GetError(res->device));
+        return false;
     }
 
     if (!res->alc.MakeContextCurrent(res->ctx)) {
-        return NULL;
+        open->error_kind = error_type;
+        open->error = std::string("alcMakeContextCurrent failed with ") + alc_error_name(res->alc.GetError(res->device));
+        return false;
     }
 
-    #define load(name) *(void **)&res->al.name = (void *)load_al_method(res->libal, "al" # name)
+    res->device_frequency = 0;
+    res->alc.GetIntegerv(res->device, ALC_FREQUENCY, 1, &res->device_frequency);
+
+    #define load(name) *(void **)&res->al.name = (void *)load_al_method(res->libal, "al" # name, &missing)
     load(Enable);
     load(Disable);
     load(IsEnabled);
@@ -736,16 +4785,361 @@ Context * modernal_meth_create_context(PyObject * self, PyObject * args, PyObjec
     load(DistanceModel);
     #undef load
 
-    if (PyErr_Occurred()) {
+    if (missing) {
+        open->error_kind = PyExc_Exception;
+        open->error = std::string(missing) + " not found";
+        return false;
+    }
+
+    res->alc.GetInteger64vSOFT = NULL;
+    if (res->alc.IsExtensionPresent(res->device, "ALC_SOFT_device_clock")) {
+        *(void **)&res->alc.GetInteger64vSOFT = res->alc.GetProcAddress(res->device, "alcGetInteger64vSOFT");
+    }
+
+    res->al.SourcePlayAtTimeSOFT = NULL;
+    if (res->al.IsExtensionPresent("AL_SOFT_source_start_delay")) {
+        *(void **)&res->al.SourcePlayAtTimeSOFT = res->al.GetProcAddress("alSourcePlayAtTimeSOFT");
+    }
+
+    res->loop_points = res->al.IsExtensionPresent("AL_SOFT_loop_points");
+
+    res->al.GetSourcei64vSOFT = NULL;
+    if (res->al.IsExtensionPresent("AL_SOFT_source_latency")) {
+        *(void **)&res->al.GetSourcei64vSOFT = res->al.GetProcAddress("alGetSourcei64vSOFT");
+    }
+
+    res->al.BufferCallbackSOFT = NULL;
+    if (res->al.IsExtensionPresent("AL_SOFT_callback_buffer")) {
+        *(void **)&res->al.BufferCallbackSOFT = res->al.GetProcAddress("alBufferCallbackSOFT");
+    }
+
+    res->al.DeferUpdatesSOFT = NULL;
+    res->al.ProcessUpdatesSOFT = NULL;
+    if (res->al.IsExtensionPresent("AL_SOFT_deferred_updates")) {
+        *(void **)&res->al.DeferUpdatesSOFT = res->al.GetProcAddress("alDeferUpdatesSOFT");
+        *(void **)&res->al.ProcessUpdatesSOFT = res->al.GetProcAddress("alProcessUpdatesSOFT");
+    }
+
+    bool efx = res->alc.IsExtensionPresent(res->device, ALC_EXT_EFX_NAME);
+    #define load(name) *(void **)&res->al.name = efx ? res->al.GetProcAddress("al" # name) : NULL
+    load(GenEffects);
+    load(DeleteEffects);
+    load(Effecti);
+    load(Effectf);
+    load(GenFilters);
+    load(DeleteFilters);
+    load(Filteri);
+    load(Filterf);
+    load(GenAuxiliaryEffectSlots);
+    load(DeleteAuxiliaryEffectSlots);
+    load(AuxiliaryEffectSloti);
+    load(AuxiliaryEffectSlotf);
+    #undef load
+    return true;
+}
+
+// Drops the reference an async open holds once the open thread is done with the context.
+
+void context_unreference(Context * self) {
+    if (self->opening->referenced) {
+        self->opening->referenced = false;
+        Py_DECREF(self);
+    }
+}
+
+// Runs once, under the GIL, on the first thread that sees the open settle.
+// Queued uploads call back into Python and may release the GIL. Other threads
+// wait for finishing to clear, and nested calls on this thread pass through.
+
+bool context_finish(Context * self) {
+    ContextOpen * open = self->opening;
+    if (open->state < 0) {
+        for (size_t i = 0; i < open->pending.size(); ++i) {
+            Py_XDECREF(open->pending[i].data);
+            Py_DECREF(open->pending[i].buffer);
+        }
+        open->pending.clear();
+        PyErr_Format(open->error_kind, "%s", open->error.c_str());
+        context_unreference(self);
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(open->lock);
+        open->finishing = true;
+    }
+    open->finisher = std::this_thread::get_id();
+
+    self->attributes = context_attributes(self);
+    self->automation->Sourcef = self->al.Sourcef;
+    self->automation->Sourcefv = self->al.Sourcefv;
+    self->scheduler->SourcePlay = self->al.SourcePlay;
+    self->scheduler->SourceStop = self->al.SourceStop;
+    if (self->commands) {
+        self->commands->GetError = self->al.GetError;
+    }
+
+    // A failed upload leaves only its own buffer empty. It is reported as a
+    // warning because the call that triggered the finish is unrelated to it.
+    std::vector<PendingUpload> pending;
+    pending.swap(open->pending);
+    std::vector<ALuint> names(pending.size());
+    bool ok = pending.empty() || al_call(self, GenBuffers, (ALsizei)pending.size(), names.data());
+    for (size_t i = 0; i < pending.size(); ++i) {
+        pending[i].buffer->alo = ok ? names[i] : 0;
+        if (ok && pending[i].data) {
+            // the queued write is the cached buffer's first upload, not a change to shared contents
+            bool cached = pending[i].buffer->cached;
+            pending[i].buffer->cached = false;
+            PyObject * call = PyObject_CallMethod(
+                (PyObject *)pending[i].buffer,
+                "write",
+                "Oiii",
+                pending[i].data,
+                pending[i].format,
+                pending[i].frequency,
+                pending[i].resample_to
+            );
+            pending[i].buffer->cached = cached;
+            Py_XDECREF(call);
+            if (!call) {
+                PyObject * type, * value, * traceback;
+                PyErr_Fetch(&type, &value, &traceback);
+                ok = PyErr_WarnFormat(PyExc_RuntimeWarning, 1, "queued upload %zu failed: %S", i, value ? value : Py_None) == 0;
+                Py_XDECREF(type);
+                Py_XDECREF(value);
+                Py_XDECREF(traceback);
+            }
+        }
+        Py_XDECREF(pending[i].data);
+        Py_DECREF(pending[i].buffer);
+    }
+
+    self->opened = true;
+    {
+        std::lock_guard<std::mutex> guard(open->lock);
+        open->finishing = false;
+        open->done.notify_all();
+    }
+    context_unreference(self);
+    return ok;
+}
+
+int context_ready(Context * self, double timeout) {
+    ContextOpen * open = self->opening;
+    while (!self->opened) {
+        if (open->finishing && open->finisher == std::this_thread::get_id()) {
+            return 1;
+        }
+        bool settled = false;
+        Py_BEGIN_ALLOW_THREADS
+        {
+            std::unique_lock<std::mutex> guard(open->lock);
+            auto ready = [open]() { return open->state != 0 && !open->finishing; };
+            if (timeout < 0.0) {
+                open->done.wait(guard, ready);
+            } else {
+                open->done.wait_for(guard, std::chrono::duration<double>(timeout), ready);
+            }
+            settled = ready();
+        }
+        Py_END_ALLOW_THREADS
+        if (self->opened) {
+            return 1;
+        }
+        if (!settled) {
+            return 0;
+        }
+        // another thread may have started the finish while this one waited for the GIL
+        if (!open->finishing) {
+            return context_finish(self) ? 1 : -1;
+        }
+    }
+    return 1;
+}
+
+void context_open_run(Context * self, ContextOpen * open) {
+    bool ok = context_open(self, open);
+    std::lock_guard<std::mutex> guard(open->lock);
+    open->state = ok ? 1 : -1;
+    open->done.notify_all();
+}
+
+Context * modernal_meth_create_context(PyObject * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {
+        "device_name",
+        "libal",
+        "debug",
+        "buffer_cache",
+        "memory_budget",
+        "grid_cell_size",
+        "max_voices",
+        "control_rate",
+        "frequency",
+        "refresh",
+        "sync",
+        "mono_sources",
+        "stereo_sources",
+        "latency",
+        "async_dispatch",
+        "async_open",
+        NULL,
+    };
+
+    const char * device_name = NULL;
+    const char * libal = DEFAULT_LIBAL;
+    int debug = false;
+    int buffer_cache = false;
+    long long memory_budget = 0;
+    float grid_cell_size = 16.0f;
+    int max_voices = 0;
+    double control_rate = 200.0;
+    int frequency = 0;
+    int refresh = 0;
+    int sync = false;
+    int mono_sources = 0;
+    int stereo_sources = 0;
+    const char * latency = NULL;
+    int async_dispatch = false;
+    int async_open = false;
+
+    int args_ok = PyArg_ParseTupleAndKeywords(
+        args,
+        kwargs,
+        "|ssppLfidiipiizpp",
+        keywords,
+        &device_name,
+        &libal,
+        &debug,
+        &buffer_cache,
+        &memory_budget,
+        &grid_cell_size,
+        &max_voices,
+        &control_rate,
+        &frequency,
+        &refresh,
+        &sync,
+        &mono_sources,
+        &stereo_sources,
+        &latency,
+        &async_dispatch,
+        &async_open
+    );
+
+    if (!args_ok) {
+        return NULL;
+    }
+
+    int profile_refresh = context_latency_refresh(latency);
+    if (profile_refresh < 0) {
+        PyErr_Format(PyExc_ValueError, "invalid latency profile %s", latency);
         return NULL;
     }
+    if (!refresh) {
+        refresh = profile_refresh;
+    }
+
+    Context * res = PyObject_New(Context, Context_type);
+    res->next = res;
+    res->prev = res;
+    res->debug = debug;
+    res->commands = NULL;
+    res->scratch.ptr = NULL;
+    res->scratch.size = 0;
+    res->scratch.busy = false;
+    res->buffer_cache = buffer_cache ? new std::unordered_map<unsigned long long, Buffer *>() : NULL;
+    res->cache_hits = 0;
+    res->cache_misses = 0;
+    res->memory_budget = memory_budget;
+    res->resident_bytes = 0;
+    res->use_clock = 0;
+    res->uid = ++context_serial;
+    res->object_serial = 0;
+    res->evictions = 0;
+    res->reuploads = 0;
+    res->grid = new EmitterGrid();
+    res->grid->cell_size = grid_cell_size > 0.0f ? grid_cell_size : 16.0f;
+    res->grid->reach = 0.0f;
+    res->grid->voices = 0;
+    res->grid->max_voices = max_voices;
+
+    res->device = NULL;
+    res->ctx = NULL;
+    res->device_frequency = 0;
+    res->attributes = NULL;
+    res->opened = false;
+    res->alc.GetInteger64vSOFT = NULL;
+
+    ContextOpen * open = new ContextOpen();
+    res->opening = open;
+    open->libal = libal;
+    open->default_device = !device_name;
+    open->device_name = device_name ? device_name : "";
+    open->state = 0;
+    open->finishing = false;
+    open->referenced = false;
+    open->error_kind = NULL;
+
+    if (frequency) {
+        open->attribs.push_back(ALC_FREQUENCY);
+        open->attribs.push_back(frequency);
+    }
+    if (refresh) {
+        open->attribs.push_back(ALC_REFRESH);
+        open->attribs.push_back(refresh);
+    }
+    if (sync) {
+        open->attribs.push_back(ALC_SYNC);
+        open->attribs.push_back(ALC_TRUE);
+    }
+    if (mono_sources) {
+        open->attribs.push_back(ALC_MONO_SOURCES);
+        open->attribs.push_back(mono_sources);
+    }
+    if (stereo_sources) {
+        open->attribs.push_back(ALC_STEREO_SOURCES);
+        open->attribs.push_back(stereo_sources);
+    }
+    open->attribs.push_back(0);
+    open->attribs.push_back(0);
+
+    res->occlusion_filter = 0;
+
+    res->automation = new Automation();
+    res->automation->Sourcef = NULL;
+    res->automation->Sourcefv = NULL;
+    res->automation->period = 1.0 / (control_rate > 0.0 ? control_rate : 200.0);
+    res->automation->started = false;
+
+    res->scheduler = new Scheduler();
+    res->scheduler->SourcePlay = NULL;
+    res->scheduler->SourceStop = NULL;
+    res->scheduler->started = false;
+
+    if (async_dispatch) {
+        CommandRing * commands = new CommandRing();
+        commands->head = 0;
+        commands->tail = 0;
+        commands->idle = false;
+        commands->GetError = NULL;
+        commands->debug = res->debug;
+        std::thread(command_ring_run, commands).detach();
+        res->commands = commands;
+    }
 
     res->listener = PyObject_New(Listener, Listener_type);
+    res->listener->ctx = res;
 
     res->consts.format_mono8 = PyLong_FromLong(AL_FORMAT_MONO8);
     res->consts.format_mono16 = PyLong_FromLong(AL_FORMAT_MONO16);
     res->consts.format_stereo8 = PyLong_FromLong(AL_FORMAT_STEREO8);
     res->consts.format_stereo16 = PyLong_FromLong(AL_FORMAT_STEREO16);
+    res->consts.format_mono_float32 = PyLong_FromLong(AL_FORMAT_MONO_FLOAT32);
+    res->consts.format_stereo_float32 = PyLong_FromLong(AL_FORMAT_STEREO_FLOAT32);
+    res->consts.format_mono_ima4 = PyLong_FromLong(AL_FORMAT_MONO_IMA4);
+    res->consts.format_stereo_ima4 = PyLong_FromLong(AL_FORMAT_STEREO_IMA4);
+    res->consts.format_mono_msadpcm = PyLong_FromLong(AL_FORMAT_MONO_MSADPCM_SOFT);
+    res->consts.format_stereo_msadpcm = PyLong_FromLong(AL_FORMAT_STEREO_MSADPCM_SOFT);
     res->consts.inverse_distance = PyLong_FromLong(AL_INVERSE_DISTANCE);
     res->consts.inverse_distance_clamped = PyLong_FromLong(AL_INVERSE_DISTANCE_CLAMPED);
     res->consts.linear_distance = PyLong_FromLong(AL_LINEAR_DISTANCE);
@@ -753,40 +5147,214 @@ Context * modernal_meth_create_context(PyObject * self, PyObject * args, PyObjec
     res->consts.exponent_distance = PyLong_FromLong(AL_EXPONENT_DISTANCE);
     res->consts.exponent_distance_clamped = PyLong_FromLong(AL_EXPONENT_DISTANCE_CLAMPED);
 
+    if (async_open) {
+        // the open thread writes into the context, so it stays alive until finished
+        open->referenced = true;
+        Py_INCREF(res);
+        std::thread(context_open_run, res, open).detach();
+    } else {
+        open->state = context_open(res, open) ? 1 : -1;
+        if (!context_finish(res)) {
+            return NULL;
+        }
+    }
     return res;
 }
 
+PyObject * Context_meth_ready(Context * self, PyObject * args) {
+    PyObject * timeout = Py_None;
+
+    if (!PyArg_ParseTuple(args, "|O", &timeout)) {
+        return NULL;
+    }
+
+    double seconds = timeout != Py_None ? PyFloat_AsDouble(timeout) : -1.0;
+    if (PyErr_Occurred()) {
+        return NULL;
+    }
+
+    int ready = context_ready(self, seconds < 0.0 && timeout != Py_None ? 0.0 : seconds);
+    if (ready < 0) {
+        return NULL;
+    }
+    return PyBool_FromLong(ready);
+}
+
+PyObject * Context_meth_flush(Context * self) {
+    if (self->commands && !command_ring_flush(self->commands)) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject * Context_meth_clock(Context * self) {
+    return PyFloat_FromDouble(context_clock(self));
+}
+
 PyObject * Context_meth_objects(Context * self) {
     PyObject * res = PyList_New(0);
     BaseObject * obj = self->next;
     while (obj != self) {
         PyList_Append(res, (PyObject *)obj);
+        obj = obj->next;
     }
     return res;
 }
 
+// The mixer pulls from the ring until the AL buffer is gone, so every source
+// playing it is stopped first and the delete is checked even without debug.
+// A failed delete keeps the ring alive and the buffer linked.
+
+bool callback_buffer_release(Context * self, CallbackBuffer * buffer) {
+    if (buffer->exports) {
+        PyErr_Format(PyExc_BufferError, "cannot release a callback buffer while a reserved view is alive");
+        return false;
+    }
+    if (!scheduler_reap(self)) {
+        return false;
+    }
+    for (BaseObject * obj = self->next; obj != self; obj = obj->next) {
+        if (Py_TYPE(obj) == Emitter_type && ((Emitter *)obj)->buffer == buffer) {
+            PyErr_Format(PyExc_ValueError, "cannot release a callback buffer used by an emitter");
+            return false;
+        }
+    }
+    for (BaseObject * obj = self->next; obj != self; obj = obj->next) {
+        Source * source = (Source *)obj;
+        if (Py_TYPE(obj) != Source_type || source->buffer != buffer) {
+            continue;
+        }
+        if (source->playing) {
+            scheduler_cancel(self->scheduler, source->alo);
+            if (!al_call(self, SourceStop, source->alo) || !al_call(self, Sourcei, source->alo, AL_BUFFER, 0)) {
+                return false;
+            }
+            buffer->bound -= 1;
+            source->playing = false;
+        }
+        source->buffer = NULL;
+        Py_DECREF(buffer);
+    }
+    if (self->commands && !command_ring_flush(self->commands)) {
+        return false;
+    }
+    self->al.GetError();
+    self->al.DeleteBuffers(1, (ALuint *)&buffer->alo);
+    int error = self->al.GetError();
+    if (error != AL_NO_ERROR) {
+        PyErr_Format(error_type, "alDeleteBuffers failed with %s", al_error_name(error));
+        return false;
+    }
+    buffer->alo = 0;
+    free(buffer->ring->data);
+    delete buffer->ring;
+    buffer->ring = NULL;
+    return true;
+}
+
 PyObject * Context_meth_release(Context * self, BaseObject * obj) {
-    obj->next->prev = obj->prev;
-    obj->prev->next = obj->next;
+    if (Py_TYPE(obj) == Buffer_type) {
+        Buffer * buffer = (Buffer *)obj;
+        buffer_uncache(buffer);
+        buffer_set_resident(buffer, false);
+        // a released clip must not be handed out again by its bank
+        Bank * bank = buffer->source_bank;
+        for (int i = 0; bank && i < bank->count; ++i) {
+            if (bank->buffers[i] == buffer) {
+                bank->buffers[i] = NULL;
+                Py_DECREF(buffer);
+            }
+        }
+        buffer_detach_source(buffer);
+    }
+    if (Py_TYPE(obj) == Source_type) {
+        // queued play_at and stop_at events must not fire on a reused name
+        scheduler_cancel(self->scheduler, ((Source *)obj)->alo);
+        if (!scheduler_reap(self)) {
+            return NULL;
+        }
+        automation_cancel_locked(self->automation, ((Source *)obj)->alo, 0);
+    }
+    if (Py_TYPE(obj) == EffectSlot_type) {
+        EffectSlot * slot = (EffectSlot *)obj;
+        if (!al_call(self, DeleteAuxiliaryEffectSlots, 1, (ALuint *)&slot->alo)) {
+            return NULL;
+        }
+        if (!al_call(self, DeleteEffects, 1, (ALuint *)&slot->effect)) {
+            return NULL;
+        }
+    }
+    if (Py_TYPE(obj) == CallbackBuffer_type && !callback_buffer_release(self, (CallbackBuffer *)obj)) {
+        return NULL;
+    }
+    if (Py_TYPE(obj) == Filter_type) {
+        if (!al_call(self, DeleteFilters, 1, (ALuint *)&((Filter *)obj)->alo)) {
+            return NULL;
+        }
+    }
+    if (Py_TYPE(obj) == Emitter_type) {
+        Emitter * emitter = (Emitter *)obj;
+        bool ok = emitter_set_audible(self, emitter, false);
+        emitter_unwait(self->grid, emitter);
+        grid_remove(self->grid, emitter);
+        Py_CLEAR(emitter->buffer);
+        Py_DECREF(emitter);
+        if (!ok) {
+            return NULL;
+        }
+    }
+    object_unlink(obj);
     Py_DECREF(obj);
     Py_RETURN_NONE;
 }
 
 PyMethodDef Context_methods[] = {
     {"buffer", (PyCFunction)Context_meth_buffer, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"generate", (PyCFunction)Context_meth_generate, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"mix", (PyCFunction)Context_meth_mix, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"load_many", (PyCFunction)Context_meth_load_many, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"atlas", (PyCFunction)Context_meth_atlas, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"callback_buffer", (PyCFunction)Context_meth_callback_buffer, METH_VARARGS | METH_KEYWORDS, NULL},
     {"source", (PyCFunction)Context_meth_source, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"open_bank", (PyCFunction)Context_meth_open_bank, METH_VARARGS, NULL},
+    {"emitter", (PyCFunction)Context_meth_emitter, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"audible", (PyCFunction)Context_meth_audible, METH_NOARGS, NULL},
     {"objects", (PyCFunction)Context_meth_objects, METH_NOARGS, NULL},
+    {"clock", (PyCFunction)Context_meth_clock, METH_NOARGS, NULL},
+    {"flush", (PyCFunction)Context_meth_flush, METH_NOARGS, NULL},
+    {"ready", (PyCFunction)Context_meth_ready, METH_VARARGS, NULL},
+    {"offsets", (PyCFunction)Context_meth_offsets, METH_VARARGS, NULL},
+    {"snapshot", (PyCFunction)Context_meth_snapshot, METH_NOARGS, NULL},
+    {"restore", (PyCFunction)Context_meth_restore, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"effect_slot", (PyCFunction)Context_meth_effect_slot, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"filter", (PyCFunction)Context_meth_filter, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"filter_gains", (PyCFunction)Context_meth_filter_gains, METH_VARARGS | METH_KEYWORDS, NULL},
     {"release", (PyCFunction)Context_meth_release, METH_O, NULL},
     {},
 };
 
 PyMemberDef Context_members[] = {
     {"listener", T_OBJECT, offsetof(Context, listener), READONLY, NULL},
+    {"debug", T_BOOL, offsetof(Context, debug), READONLY, NULL},
+    {"device_frequency", T_INT, offsetof(Context, device_frequency), READONLY, NULL},
+    {"attributes", T_OBJECT, offsetof(Context, attributes), READONLY, NULL},
+    {"cache_hits", T_INT, offsetof(Context, cache_hits), READONLY, NULL},
+    {"cache_misses", T_INT, offsetof(Context, cache_misses), READONLY, NULL},
+    {"memory_budget", T_LONGLONG, offsetof(Context, memory_budget), 0, NULL},
+    {"resident_bytes", T_LONGLONG, offsetof(Context, resident_bytes), READONLY, NULL},
+    {"evictions", T_INT, offsetof(Context, evictions), READONLY, NULL},
+    {"reuploads", T_INT, offsetof(Context, reuploads), READONLY, NULL},
 
     {"FORMAT_MONO8", T_OBJECT, offsetof(Context, consts.format_mono8), READONLY, NULL},
     {"FORMAT_MONO16", T_OBJECT, offsetof(Context, consts.format_mono16), READONLY, NULL},
     {"FORMAT_STEREO8", T_OBJECT, offsetof(Context, consts.format_stereo8), READONLY, NULL},
     {"FORMAT_STEREO16", T_OBJECT, offsetof(Context, consts.format_stereo16), READONLY, NULL},
+    {"FORMAT_MONO_FLOAT32", T_OBJECT, offsetof(Context, consts.format_mono_float32), READONLY, NULL},
+    {"FORMAT_STEREO_FLOAT32", T_OBJECT, offsetof(Context, consts.format_stereo_float32), READONLY, NULL},
+    {"FORMAT_MONO_IMA4", T_OBJECT, offsetof(Context, consts.format_mono_ima4), READONLY, NULL},
+    {"FORMAT_STEREO_IMA4", T_OBJECT, offsetof(Context, consts.format_stereo_ima4), READONLY, NULL},
+    {"FORMAT_MONO_MSADPCM", T_OBJECT, offsetof(Context, consts.format_mono_msadpcm), READONLY, NULL},
+    {"FORMAT_STEREO_MSADPCM", T_OBJECT, offsetof(Context, consts.format_stereo_msadpcm), READONLY, NULL},
     {"INVERSE_DISTANCE", T_OBJECT, offsetof(Context, consts.inverse_distance), READONLY, NULL},
     {"INVERSE_DISTANCE_CLAMPED", T_OBJECT, offsetof(Context, consts.inverse_distance_clamped), READONLY, NULL},
     {"LINEAR_DISTANCE", T_OBJECT, offsetof(Context, consts.linear_distance), READONLY, NULL},
@@ -807,6 +5375,7 @@ PyType_Spec Context_spec = {"modernal.Context", sizeof(Context), 0, Py_TPFLAGS_D
 
 PyMethodDef module_methods[] = {
     {"create_context", (PyCFunction)modernal_meth_create_context, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"pack_bank", (PyCFunction)modernal_meth_pack_bank, METH_VARARGS, NULL},
     {},
 };
 
@@ -816,16 +5385,30 @@ extern "C" PyObject * PyInit_modernal() {
     PyObject * module = PyModule_Create(&module_def);
 
     empty_tuple = PyTuple_New(0);
+    error_type = PyErr_NewException("modernal.Error", NULL, NULL);
 
     Context_type = (PyTypeObject *)PyType_FromSpec(&Context_spec);
     Buffer_type = (PyTypeObject *)PyType_FromSpec(&Buffer_spec);
     Listener_type = (PyTypeObject *)PyType_FromSpec(&Listener_spec);
     Source_type = (PyTypeObject *)PyType_FromSpec(&Source_spec);
+    Bank_type = (PyTypeObject *)PyType_FromSpec(&Bank_spec);
+    Emitter_type = (PyTypeObject *)PyType_FromSpec(&Emitter_spec);
+    EffectSlot_type = (PyTypeObject *)PyType_FromSpec(&EffectSlot_spec);
+    Filter_type = (PyTypeObject *)PyType_FromSpec(&Filter_spec);
+    PyObject * callback_buffer_bases = PyTuple_Pack(1, Buffer_type);
+    CallbackBuffer_type = (PyTypeObject *)PyType_FromSpecWithBases(&CallbackBuffer_spec, callback_buffer_bases);
+    Py_DECREF(callback_buffer_bases);
 
     PyModule_AddObject(module, "Context", (PyObject *)Context_type);
     PyModule_AddObject(module, "Buffer", (PyObject *)Buffer_type);
     PyModule_AddObject(module, "Listener", (PyObject *)Listener_type);
     PyModule_AddObject(module, "Source", (PyObject *)Source_type);
+    PyModule_AddObject(module, "Bank", (PyObject *)Bank_type);
+    PyModule_AddObject(module, "Emitter", (PyObject *)Emitter_type);
+    PyModule_AddObject(module, "EffectSlot", (PyObject *)EffectSlot_type);
+    PyModule_AddObject(module, "Filter", (PyObject *)Filter_type);
+    PyModule_AddObject(module, "CallbackBuffer", (PyObject *)CallbackBuffer_type);
+    PyModule_AddObject(module, "Error", new_ref(error_type));
 
     return module;
 }
@@ -310,3 +310,107 @@ typedef void (ALC_APIENTRY *LPALCCAPTURESAMPLES)( ALCdevice *device, ALCvoid *bu
 #endif
 
 #endif
+
+#ifndef AL_ALEXT_H
+#define AL_ALEXT_H
+
+#define AL_FORMAT_MONO_FLOAT32 0x10010
+#define AL_FORMAT_STEREO_FLOAT32 0x10011
+#define AL_FORMAT_MONO_IMA4 0x1300
+#define AL_FORMAT_STEREO_IMA4 0x1301
+#define AL_FORMAT_MONO_MSADPCM_SOFT 0x1302
+#define AL_FORMAT_STEREO_MSADPCM_SOFT 0x1303
+#define AL_UNPACK_BLOCK_ALIGNMENT_SOFT 0x200C
+#define AL_PACK_BLOCK_ALIGNMENT_SOFT 0x200D
+#define ALC_DEVICE_CLOCK_SOFT 0x1600
+#define ALC_DEVICE_LATENCY_SOFT 0x1601
+#define ALC_DEVICE_CLOCK_LATENCY_SOFT 0x1602
+#define AL_LOOP_POINTS_SOFT 0x2015
+#define AL_BUFFER_CALLBACK_FUNCTION_SOFT 0x19A0
+#define AL_BUFFER_CALLBACK_USER_PARAM_SOFT 0x19A1
+#define AL_SAMPLE_OFFSET_LATENCY_SOFT 0x1200
+#define AL_SEC_OFFSET_LATENCY_SOFT 0x1201
+#define AL_SAMPLE_OFFSET_CLOCK_SOFT 0x1202
+#define AL_SEC_OFFSET_CLOCK_SOFT 0x1203
+
+#define ALC_EXT_EFX_NAME "ALC_EXT_EFX"
+#define ALC_MAX_AUXILIARY_SENDS 0x20003
+#define AL_DIRECT_FILTER 0x20005
+#define AL_AUXILIARY_SEND_FILTER 0x20006
+#define AL_EFFECTSLOT_EFFECT 0x0001
+#define AL_EFFECTSLOT_GAIN 0x0002
+#define AL_EFFECTSLOT_NULL 0x0000
+#define AL_EFFECT_TYPE 0x8001
+#define AL_EFFECT_NULL 0x0000
+#define AL_EFFECT_REVERB 0x0001
+#define AL_EFFECT_CHORUS 0x0002
+#define AL_EFFECT_ECHO 0x0004
+#define AL_REVERB_DENSITY 0x0001
+#define AL_REVERB_DIFFUSION 0x0002
+#define AL_REVERB_GAIN 0x0003
+#define AL_REVERB_GAINHF 0x0004
+#define AL_REVERB_DECAY_TIME 0x0005
+#define AL_REVERB_DECAY_HFRATIO 0x0006
+#define AL_REVERB_REFLECTIONS_GAIN 0x0007
+#define AL_REVERB_REFLECTIONS_DELAY 0x0008
+#define AL_REVERB_LATE_REVERB_GAIN 0x0009
+#define AL_REVERB_LATE_REVERB_DELAY 0x000A
+#define AL_REVERB_AIR_ABSORPTION_GAINHF 0x000B
+#define AL_REVERB_ROOM_ROLLOFF_FACTOR 0x000C
+#define AL_REVERB_DECAY_HFLIMIT 0x000D
+#define AL_CHORUS_WAVEFORM 0x0001
+#define AL_CHORUS_PHASE 0x0002
+#define AL_CHORUS_RATE 0x0003
+#define AL_CHORUS_DEPTH 0x0004
+#define AL_CHORUS_FEEDBACK 0x0005
+#define AL_CHORUS_DELAY 0x0006
+#define AL_ECHO_DELAY 0x0001
+#define AL_ECHO_LRDELAY 0x0002
+#define AL_ECHO_DAMPING 0x0003
+#define AL_ECHO_FEEDBACK 0x0004
+#define AL_ECHO_SPREAD 0x0005
+#define AL_FILTER_TYPE 0x8001
+#define AL_FILTER_NULL 0x0000
+#define AL_FILTER_LOWPASS 0x0001
+#define AL_FILTER_HIGHPASS 0x0002
+#define AL_FILTER_BANDPASS 0x0003
+#define AL_LOWPASS_GAIN 0x0001
+#define AL_LOWPASS_GAINHF 0x0002
+#define AL_HIGHPASS_GAIN 0x0001
+#define AL_HIGHPASS_GAINLF 0x0002
+#define AL_BANDPASS_GAIN 0x0001
+#define AL_BANDPASS_GAINLF 0x0002
+#define AL_BANDPASS_GAINHF 0x0003
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef long long ALint64SOFT;
+typedef long long ALCint64SOFT;
+
+typedef void (AL_APIENTRY *LPALSOURCEPLAYATTIMESOFT)( ALuint source, ALint64SOFT start_time );
+typedef void (AL_APIENTRY *LPALGETSOURCEI64VSOFT)( ALuint source, ALenum param, ALint64SOFT *values );
+typedef void (AL_APIENTRY *LPALGENEFFECTS)( ALsizei n, ALuint *effects );
+typedef void (AL_APIENTRY *LPALDELETEEFFECTS)( ALsizei n, const ALuint *effects );
+typedef void (AL_APIENTRY *LPALEFFECTI)( ALuint effect, ALenum param, ALint value );
+typedef void (AL_APIENTRY *LPALEFFECTF)( ALuint effect, ALenum param, ALfloat value );
+typedef void (AL_APIENTRY *LPALGENFILTERS)( ALsizei n, ALuint *filters );
+typedef void (AL_APIENTRY *LPALDELETEFILTERS)( ALsizei n, const ALuint *filters );
+typedef void (AL_APIENTRY *LPALFILTERI)( ALuint filter, ALenum param, ALint value );
+typedef void (AL_APIENTRY *LPALFILTERF)( ALuint filter, ALenum param, ALfloat value );
+typedef void (AL_APIENTRY *LPALGENAUXILIARYEFFECTSLOTS)( ALsizei n, ALuint *slots );
+typedef void (AL_APIENTRY *LPALDELETEAUXILIARYEFFECTSLOTS)( ALsizei n, const ALuint *slots );
+typedef void (AL_APIENTRY *LPALAUXILIARYEFFECTSLOTI)( ALuint slot, ALenum param, ALint value );
+typedef void (AL_APIENTRY *LPALAUXILIARYEFFECTSLOTF)( ALuint slot, ALenum param, ALfloat value );
+typedef void (AL_APIENTRY *LPALDEFERUPDATESSOFT)( void );
+typedef void (AL_APIENTRY *LPALPROCESSUPDATESSOFT)( void );
+typedef ALsizei (AL_APIENTRY *ALBUFFERCALLBACKTYPESOFT)( ALvoid *userptr, ALvoid *sampledata, ALsizei numbytes );
+typedef void (AL_APIENTRY *LPALBUFFERCALLBACKSOFT)( ALuint buffer, ALenum format, ALsizei freq, ALBUFFERCALLBACKTYPESOFT callback, ALvoid *userptr );
+typedef void (ALC_APIENTRY *LPALCGETINTEGER64VSOFT)( ALCdevice *device, ALCenum pname, ALsizei size, ALCint64SOFT *values );
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef MODERNAL_XXHASH_HPP
+#define MODERNAL_XXHASH_HPP
+
+#include <string.h>
+
+// XXH64 from https://github.com/Cyan4973/xxHash
+
+const unsigned long long xxh_prime1 = 11400714785074694791ULL;
+const unsigned long long xxh_prime2 = 14029467366897019727ULL;
+const unsigned long long xxh_prime3 = 1609587929392839161ULL;
+const unsigned long long xxh_prime4 = 9650029242287828579ULL;
+const unsigned long long xxh_prime5 = 2870177450012600261ULL;
+
+inline unsigned long long xxh_rotl(unsigned long long x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+inline unsigned long long xxh_read64(const unsigned char * ptr) {
+    unsigned long long res;
+    memcpy(&res, ptr, 8);
+    return res;
+}
+
+inline unsigned long long xxh_read32(const unsigned char * ptr) {
+    unsigned res;
+    memcpy(&res, ptr, 4);
+    return res;
+}
+
+inline unsigned long long xxh_round(unsigned long long acc, unsigned long long input) {
+    acc += input * xxh_prime2;
+    acc = xxh_rotl(acc, 31);
+    return acc * xxh_prime1;
+}
+
+inline unsigned long long xxh_merge(unsigned long long acc, unsigned long long value) {
+    acc ^= xxh_round(0, value);
+    return acc * xxh_prime1 + xxh_prime4;
+}
+
+inline unsigned long long xxh64(const void * data, size_t size, unsigned long long seed) {
+    const unsigned char * ptr = (const unsigned char *)data;
+    const unsigned char * end = ptr + size;
+    unsigned long long res;
+
+    if (size >= 32) {
+        unsigned long long v1 = seed + xxh_prime1 + xxh_prime2;
+        unsigned long long v2 = seed + xxh_prime2;
+        unsigned long long v3 = seed;
+        unsigned long long v4 = seed - xxh_prime1;
+        while (ptr + 32 <= end) {
+            v1 = xxh_round(v1, xxh_read64(ptr));
+            v2 = xxh_round(v2, xxh_read64(ptr + 8));
+            v3 = xxh_round(v3, xxh_read64(ptr + 16));
+            v4 = xxh_round(v4, xxh_read64(ptr + 24));
+            ptr += 32;
+        }
+        res = xxh_rotl(v1, 1) + xxh_rotl(v2, 7) + xxh_rotl(v3, 12) + xxh_rotl(v4, 18);
+        res = xxh_merge(res, v1);
+        res = xxh_merge(res, v2);
+        res = xxh_merge(res, v3);
+        res = xxh_merge(res, v4);
+    } else {
+        res = seed + xxh_prime5;
+    }
+
+    res += size;
+
+    while (ptr + 8 <= end) {
+        res ^= xxh_round(0, xxh_read64(ptr));
+        res = xxh_rotl(res, 27) * xxh_prime1 + xxh_prime4;
+        ptr += 8;
+    }
+
+    if (ptr + 4 <= end) {
+        res ^= xxh_read32(ptr) * xxh_prime1;
+        res = xxh_rotl(res, 23) * xxh_prime2 + xxh_prime3;
+        ptr += 4;
+    }
+
+    while (ptr < end) {
+        res ^= *ptr * xxh_prime5;
+        res = xxh_rotl(res, 11) * xxh_prime1;
+        ptr += 1;
+    }
+
+    res ^= res >> 33;
+    res *= xxh_prime2;
+    res ^= res >> 29;
+    res *= xxh_prime3;
+    res ^= res >> 32;
+    return res;
+}
+
+#endif
@@ -53,6 +53,8 @@ modernal = Extension(
     ],
     depends=[
         'modernal/openal.hpp',
+        'modernal/dsp.hpp',
+        'modernal/xxhash.hpp',
         'setup.py',
     ],
 )